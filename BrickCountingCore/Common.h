@@ -7,6 +7,9 @@ Commonly used definitions.
 
 //#define _TRACE 1
 //#define _COMPARE_ALGORITHMS 1
+// Same level bricks: Use the separating axis test instead of POIs. See Brick::boxesIntersect().
+// Off until a full count using it has been compared to one using the POIs.
+//#define _SAT_BOX_INTERSECTION 1
 
 // Ensure cross platform compatibility of std::min and std::max:
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
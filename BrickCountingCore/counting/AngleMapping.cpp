@@ -2,9 +2,12 @@
 
 #include <time.h>
 #include <sstream>
+#include <thread>
+#include <algorithm>
 
 #include "../Common.h"
 #include "../util/MPDPrinter.h"
+#include "../util/ProgressWriter.hpp"
 #include "../modelling/Brick.h"
 #include "../modelling/Model.hpp"
 #include "../modelling/TurningSingleBrick.h"
@@ -30,7 +33,7 @@ namespace geometry {
 namespace counting {
 	void AngleMapping::init() {
 		// Boosts:
-		for (int i = 0; i < BOOST_STAGES; ++i)
+		for (int i = 0; i < BOOST_COUNTERS; ++i)
 			boosts[i] = 0;
 
 		setupAngleTypes();
@@ -56,27 +59,45 @@ namespace counting {
 			}
 		}
 		singleFreeAngle = numFreeAngles == 1;
+		createLastTurningBlock();
 
 		if (findExtremeAnglesOnly)
 			return; // no setup of smappings.
 
+		// Part of the SML grid to evaluate. A boosted run only evaluates the region around the deferred S-islands and one step (before boosting) more:
+		for (unsigned int i = 0; i < numAngles - 1; ++i) {
+			gridFirst[i] = 0;
+			gridSize[i] = 2 * angleSteps[i] + 1;
+			if (boostPrecision && hasBoostRegion) {
+				const int first = MAX(0, ((int)boostRegionMin[i] - 1) * PRECISION_BOOST_MULTIPLIER);
+				const int last = MIN(2 * (int)angleSteps[i], ((int)boostRegionMax[i] + 1) * PRECISION_BOOST_MULTIPLIER);
+				gridFirst[i] = (unsigned short)first;
+				gridSize[i] = (unsigned short)(last - first + 1);
+			}
+		}
+
 		  // sizeMappings:
 		sizeMappings = 1;
 		for (unsigned int i = 0; i < numAngles - 1; ++i) {
-			sizeMappings *= (2 * angleSteps[i] + 1);
+			sizeMappings *= gridSize[i];
 		}
 #ifdef _TRACE
 		std::cout << "SML size " << sizeMappings << std::endl;
 #endif
 
-		// S, M & L:
-		SS = new geometry::IntervalListVector(sizeMappings, MAX_LOAD_FACTOR); // deleted in ~AngleMapping() and setDoublePrecision()
-		MM = new geometry::IntervalListVector(sizeMappings, MAX_LOAD_FACTOR); // deleted in ~AngleMapping() and setDoublePrecision()
-		LL = new geometry::IntervalListVector(sizeMappings, MAX_LOAD_FACTOR); // deleted in ~AngleMapping() and setDoublePrecision()
+		// S, M & L. With more than 2 angles, hyperplanes are evaluated into local storage by evalSMLSliceWorker():
+		if (numAngles > 2) {
+			SS = MM = LL = NULL;
+			return;
+		}
+		arena.reset(arena.sml, sizeMappings);
+		SS = &arena.sml.S;
+		MM = &arena.sml.M;
+		LL = &arena.sml.L;
 	}
 
-	AngleMapping::AngleMapping(FatBlock const * const blocks, int numBlock, const util::TinyVector<IConnectionPair, 5> &cs, const ModelEncoder &encoder, std::ofstream &os, bool findExtremeAnglesOnly) :
-		numAngles(numBlock - 1), numBricks(0), encoder(encoder), findExtremeAnglesOnly(findExtremeAnglesOnly), os(os), boostPrecision(false) {
+	AngleMapping::AngleMapping(FatBlock const * const blocks, int numBlock, const util::TinyVector<IConnectionPair, 5> &cs, const ModelEncoder &encoder, SMLArena &arena, std::ostream &os, bool findExtremeAnglesOnly) :
+		numAngles(numBlock - 1), numBricks(0), encoder(encoder), arena(arena), findExtremeAnglesOnly(findExtremeAnglesOnly), os(os), boostPrecision(false), hasBoostRegion(false) {
 		// Simple copying:
 		for (int i = 0; i < numBlock; ++i) {
 			this->blocks[i] = blocks[i];
@@ -96,11 +117,39 @@ namespace counting {
 	}
 
 	AngleMapping::~AngleMapping() {
+	}
+
+	/*
+	Creates the TurningSingleBricks of the last block for the tolerances used by the TurningBlockInvestigators at the end of the recursion of evalSML() and evalExtremeModels().
+	*/
+	void AngleMapping::createLastTurningBlock() {
+		lastTurningBlock.clear();
+		const unsigned int angleI = numAngles - 1;
+		if (angleTypes[angleI] == 0)
+			return; // The block does not turn.
+		const IConnectionPoint &ip2 = points[2 * angleI + 1];
+		const FatBlock &block = blocks[ip2.first.modelBlockI];
+		const ConnectionPoint &point = ip2.second;
+
+		lastTurningBlock.create<0>(block, point);
 		if (findExtremeAnglesOnly)
-			return; // no setup of mappings.
-		delete SS;
-		delete MM;
-		delete LL;
+			return;
+		if (singleFreeAngle)
+			createLastTurningBlock<SingleFreeAngleTolerances>(block, point);
+		else if (boostPrecision)
+			createLastTurningBlock<BoostedTolerances>(block, point);
+		else
+			createLastTurningBlock<MoldingTolerances>(block, point);
+	}
+
+	template <typename Tolerances>
+	void AngleMapping::createLastTurningBlock(const FatBlock &block, const ConnectionPoint &point) {
+		lastTurningBlock.create<-Tolerances::TOLERANCE>(block, point);
+		lastTurningBlock.create<Tolerances::TOLERANCE>(block, point);
+		if (Tolerances::INTERVAL_TOLERANCE != Tolerances::TOLERANCE) {
+			lastTurningBlock.create<-Tolerances::INTERVAL_TOLERANCE>(block, point);
+			lastTurningBlock.create<Tolerances::INTERVAL_TOLERANCE>(block, point);
+		}
 	}
 
 	void AngleMapping::setupAngleTypes() {
@@ -186,7 +235,7 @@ namespace counting {
 		for (unsigned int i = 0; i < numAngles - 1; ++i) {
 			const IConnectionPoint &ip1 = points[2 * i];
 			const IConnectionPoint &ip2 = points[2 * i + 1];
-			const StepAngle angle((short)p.p[i] - (short)angleSteps[i], angleSteps[i] == 0 ? 1 : angleSteps[i]);
+			const StepAngle angle((short)(p.p[i] + gridFirst[i]) - (short)angleSteps[i], angleSteps[i] == 0 ? 1 : angleSteps[i]);
 			const AngledConnection cc(ip1, ip2, angle);
 			assert(ip2.P1.modelBlockI != 0);
 			c.add(blocks[ip2.P1.modelBlockI], ip2.P1.modelBlockI, cc);
@@ -232,7 +281,7 @@ namespace counting {
 		for (unsigned int i = 0; i < numAngles - 1; ++i) {
 			const IConnectionPoint &ip1 = points[2 * i];
 			const IConnectionPoint &ip2 = points[2 * i + 1];
-			const StepAngle angle((short)p.p[i] - (short)angleSteps[i], angleSteps[i] == 0 ? 1 : angleSteps[i]);
+			const StepAngle angle((short)(p.p[i] + gridFirst[i]) - (short)angleSteps[i], angleSteps[i] == 0 ? 1 : angleSteps[i]);
 			result.push_back(AngledConnection(ip1, ip2, angle));
 		}
 
@@ -244,49 +293,144 @@ namespace counting {
 
 	void AngleMapping::setBoostPrecision() {
 		assert(!findExtremeAnglesOnly);
-		delete SS;
-		delete MM;
-		delete LL;
-
 		boostPrecision = true;
 		init();
 	}
 
+	/*
+	Evaluates the SML matrix into stream using the tolerances of Tolerances.
+	*/
+	template <typename Tolerances>
+	void AngleMapping::evalSMLMatrix(Model &c, SMLStream &stream) {
+		if (numAngles > 2) {
+			evalSMLSlices<Tolerances>(c, stream);
+			return;
+		}
+		SMLSlice out(SS, MM, LL, 0, boosts);
+		findUnreachableSteps(c);
+		evalSML<Tolerances>(0, 0, c, false, false, false, out);
+		for (uint32_t i = 0; i < sizeMappings; ++i)
+			stream.add(*SS, *MM, *LL, i); // Each hyperplane is a single location.
+	}
+
+	/*
+	S, M and L of the mirror image of the connection list give those of this connection list:
+	Mirroring negates all angles, so location i is location sizeMappings-1-i of the mirror image, and the intervals of the last angle are negated.
+	*/
+	void AngleMapping::mirrorSMLMatrix(const SMLBuffers &mirror, SMLStream &stream) {
+		assert(numAngles <= 2 && !boostPrecision);
+		assert(mirror.S.sizeIndicator() == sizeMappings);
+		const geometry::IntervalListVector *from[3] = { &mirror.S, &mirror.M, &mirror.L };
+		geometry::IntervalListVector *to[3] = { SS, MM, LL };
+		for (int k = 0; k < 3; ++k) {
+			for (uint32_t i = 0; i < sizeMappings; ++i) {
+				geometry::IntervalList l, m;
+				from[k]->get(sizeMappings - 1 - i, l);
+				for (int j = (int)l.size() - 1; j >= 0; --j)
+					m.push_back(geometry::Interval(-l[j].second, -l[j].first));
+				to[k]->insert(i, m);
+			}
+		}
+		for (uint32_t i = 0; i < sizeMappings; ++i)
+			stream.add(*SS, *MM, *LL, i);
+	}
+
+	/*
+	Key of the geometry which determines S, M and L: The bricks of each block at the rectilinear angles and the blocks, steps and pivot of each angle.
+	Positions are in half studs relative to the first pivot, and levels are relative to the lowest brick.
+	The key is the smallest over the 4 rectilinear rotations of the model, so it does not depend on how the model is turned.
+	If mirrored, then the key is that of the mirror image of the model.
+	*/
+	void AngleMapping::getSymmetryKey(bool mirrored, std::vector<int> &key) const {
+		Model c(blocks[0]);
+		geometry::Point pivots[5];
+		for (unsigned int i = 0; i < numAngles; ++i) {
+			const IConnectionPoint &ip1 = points[2 * i];
+			pivots[i] = Brick(c.origBricks[ip1.first.modelBlockI], ip1.second.brick).getStudPosition(ip1.second.type);
+			c = getModel(c, i, angleSteps[i]);
+		}
+		int minLevel = c.bricks[0].b.level;
+		for (int i = 1; i < c.bricksSize; ++i)
+			minLevel = MIN(minLevel, c.bricks[i].b.level);
+
+		key.clear();
+		for (int rotation = 0; rotation < 4; ++rotation) {
+			std::vector<int> k;
+			int xy[12]; // Pivots followed by a brick center.
+			for (unsigned int i = 0; i < numAngles; ++i) {
+				xy[2 * i] = (int)geometry::round(2 * (pivots[i].X - pivots[0].X));
+				xy[2 * i + 1] = (int)geometry::round(2 * (pivots[i].Y - pivots[0].Y));
+			}
+			for (unsigned int b = 0; b <= numAngles; ++b) {
+				std::vector<int> bricks;
+				for (int i = 0; i < c.bricksSize; ++i) {
+					const IBrick &ib = c.bricks[i];
+					if (ib.bi.modelBlockI != (int)b)
+						continue;
+					int x = (int)geometry::round(2 * (ib.b.center.X - pivots[0].X));
+					int y = (int)geometry::round(2 * (ib.b.center.Y - pivots[0].Y));
+					const bool horizontal = (fabs(sin(ib.b.angle)) > 0.5) != (rotation % 2 == 1);
+					if (mirrored)
+						x = -x;
+					for (int j = 0; j < rotation; ++j) {
+						const int tmp = x;
+						x = -y;
+						y = tmp;
+					}
+					bricks.push_back((((x + 128) << 16 | (y + 128) << 8 | (ib.b.level - minLevel)) << 1) | (horizontal ? 1 : 0));
+				}
+				std::sort(bricks.begin(), bricks.end());
+				k.push_back((int)bricks.size());
+				k.insert(k.end(), bricks.begin(), bricks.end());
+			}
+			for (unsigned int i = 0; i < numAngles; ++i) {
+				int x = xy[2 * i], y = xy[2 * i + 1];
+				if (mirrored)
+					x = -x;
+				for (int j = 0; j < rotation; ++j) {
+					const int tmp = x;
+					x = -y;
+					y = tmp;
+				}
+				k.push_back(points[2 * i].first.modelBlockI);
+				k.push_back(points[2 * i + 1].first.modelBlockI);
+				k.push_back(angleSteps[i]);
+				k.push_back(x);
+				k.push_back(y);
+			}
+			if (key.empty() || k < key)
+				key = k;
+		}
+	}
+
 	/*
 	Evaluate the SML matrix.
 	Parameters:
 	- angleI: Used as recursion index in angles. Initialize with 0.
 	- smlI: Index into SML. Initially 0.
-	- c: Model being constructed dynamically. Initially containing blocks[0].
-	- possibleCollisions: possible connections pre-computed to be used in next step. Remember to initialize!
+	- c: Model being constructed dynamically. Initially containing blocks[0]. Blocks are pushed and popped in place, so c is unchanged on return.
+	- noS, noM, noL: S, M or L is not realizable at the angles fixed so far. Only empty entries are written for them.
+	- out: S, M and L to write to.
 	*/
-	void AngleMapping::evalSML(unsigned int angleI, uint32_t smlI, const Model &c, bool noS, bool noM, bool noL) {
+	template <typename Tolerances>
+	void AngleMapping::evalSML(unsigned int angleI, uint32_t smlI, Model &c, bool noS, bool noM, bool noL, SMLSlice &out) {
 		// Find possible collisions:
 		const IConnectionPoint &ip1 = points[2 * angleI];
 		const IConnectionPoint &ip2 = points[2 * angleI + 1];
 		unsigned int ip2I = ip2.first.modelBlockI;
 		util::TinyVector<int, 5> possibleCollisions;
-		c.getPossibleCollisions(blocks[ip2I], IConnectionPair(ip1, ip2), possibleCollisions);
+		c.getSweptPossibleCollisions(blocks[ip2I], IConnectionPair(ip1, ip2), possibleCollisions);
+		BlockPlacement placement;
+		c.getBlockPlacement(ip2I, IConnectionPair(ip1, ip2), placement);
 
 		// Recursion:
 		if (angleI < numAngles - 1) {
 			// Update smlI:
 			assert(smlI < sizeMappings);
-			const unsigned short steps = 2 * angleSteps[angleI] + 1;
-			smlI *= steps;
-
-			for (unsigned short i = 0; i < steps; ++i) {
-				Model c2 = getModel(c, angleI, i);
-				bool noS2 = noS || !(singleFreeAngle ? c2.isRealizable<-EPSILON_TOLERANCE_MULTIPLIER>(possibleCollisions, blocks[ip2I].size) :
-					(boostPrecision ? c2.isRealizable<-MOLDING_TOLERANCE_MULTIPLIER / PRECISION_BOOST_MULTIPLIER>(possibleCollisions, blocks[ip2I].size) :
-						c2.isRealizable<-MOLDING_TOLERANCE_MULTIPLIER>(possibleCollisions, blocks[ip2I].size)));
-				bool noM2 = noM || !c2.isRealizable<0>(possibleCollisions, blocks[ip2I].size);
-				bool noL2 = noL || !(singleFreeAngle ? c2.isRealizable<EPSILON_TOLERANCE_MULTIPLIER>(possibleCollisions, blocks[ip2I].size) :
-					(boostPrecision ? c2.isRealizable<MOLDING_TOLERANCE_MULTIPLIER / PRECISION_BOOST_MULTIPLIER>(possibleCollisions, blocks[ip2I].size) :
-						c2.isRealizable<MOLDING_TOLERANCE_MULTIPLIER>(possibleCollisions, blocks[ip2I].size)));
-
-				evalSML(angleI + 1, smlI + i, c2, noS2, noM2, noL2);
-			}
+			smlI *= gridSize[angleI];
+			BrickSoA collisionBricks;
+			c.getCollisionBricks(possibleCollisions, collisionBricks);
+			evalSMLSteps<Tolerances>(angleI, smlI, 0, gridSize[angleI], c, placement, possibleCollisions, collisionBricks, noS, noM, noL, false, false, false, out);
 			return;
 		}
 
@@ -294,60 +438,54 @@ namespace counting {
 		assert(angleI == numAngles - 1);
 
 		// Speed up for noSML:
-		if (noS) SS->insertEmpty(smlI);
-		if (noM) MM->insertEmpty(smlI);
-		if (noL) LL->insertEmpty(smlI);
+		if (noS) out.S->insertEmpty(smlI - out.offset);
+		if (noM) out.M->insertEmpty(smlI - out.offset);
+		if (noL) out.L->insertEmpty(smlI - out.offset);
 		bool sDone = noS;
 		bool mDone = noM;
 		bool lDone = noL;
-		if (sDone && mDone && lDone) {
-			++boosts[0];
-			return;
-		}
+		assert(!(sDone && mDone && lDone)); // Handled by insertEmptySubMatrix().
 #ifdef _TRACE
 		std::cout << "NO SML statuses: " << noS << ", " << noM << ", " << noL << std::endl;
 #endif
 
 		if (angleTypes[angleI] == 0) {
-			Model c2 = getModel(c, angleI, 0);
 			geometry::IntervalList full;
 			full.push_back(geometry::Interval(-EPSILON, EPSILON));
 
+			BrickSoA collisionBricks;
+			c.getCollisionBricks(possibleCollisions, collisionBricks);
+			bool realizableS = !sDone, realizableM = !mDone, realizableL = !lDone;
+			c.push(blocks[ip2I], placement, StepAngle(-(short)angleSteps[angleI], angleSteps[angleI] == 0 ? 1 : angleSteps[angleI]).toRadians());
+			isRealizableSML<Tolerances>(c, ip2I, collisionBricks, realizableS, realizableM, realizableL);
+			c.pop(blocks[ip2I]);
 			if (!sDone) {
-				bool realizable = singleFreeAngle ? c2.isRealizable<-EPSILON_TOLERANCE_MULTIPLIER>(possibleCollisions, blocks[ip2I].size) :
-					(boostPrecision ? c2.isRealizable<-MOLDING_TOLERANCE_MULTIPLIER / PRECISION_BOOST_MULTIPLIER>(possibleCollisions, blocks[ip2I].size) :
-						c2.isRealizable<-MOLDING_TOLERANCE_MULTIPLIER>(possibleCollisions, blocks[ip2I].size));
-				if (realizable)
-					SS->insert(smlI, full);
+				if (realizableS)
+					out.S->insert(smlI - out.offset, full);
 				else
-					SS->insertEmpty(smlI);
+					out.S->insertEmpty(smlI - out.offset);
 			}
 			if (!mDone) {
-				if (c2.isRealizable<0>(possibleCollisions, blocks[ip2I].size))
-					MM->insert(smlI, full);
+				if (realizableM)
+					out.M->insert(smlI - out.offset, full);
 				else
-					MM->insertEmpty(smlI);
+					out.M->insertEmpty(smlI - out.offset);
 			}
 			if (!lDone) {
-				bool realizable = singleFreeAngle ? c2.isRealizable<EPSILON_TOLERANCE_MULTIPLIER>(possibleCollisions, blocks[ip2I].size) :
-					(boostPrecision ? c2.isRealizable<MOLDING_TOLERANCE_MULTIPLIER / PRECISION_BOOST_MULTIPLIER>(possibleCollisions, blocks[ip2I].size) :
-						c2.isRealizable<MOLDING_TOLERANCE_MULTIPLIER>(possibleCollisions, blocks[ip2I].size));
-				if (realizable)
-					LL->insert(smlI, full);
+				if (realizableL)
+					out.L->insert(smlI - out.offset, full);
 				else
-					LL->insertEmpty(smlI);
+					out.L->insertEmpty(smlI - out.offset);
 			}
-			++boosts[1];
+			++out.boosts[1];
 			return;
 		}
 
 		const IConnectionPair icp(ip1, ip2);
-		TurningBlockInvestigator tsbInvestigator(c, blocks[ip2I], ip2I, icp);
+		TurningBlockInvestigator tsbInvestigator(c, blocks[ip2I], ip2I, icp, &lastTurningBlock);
 
 		// First check quick clear:
-		if (!sDone && (singleFreeAngle ? tsbInvestigator.isClear<-EPSILON_TOLERANCE_MULTIPLIER>(possibleCollisions) :
-			(boostPrecision ? tsbInvestigator.isClear<-MOLDING_TOLERANCE_MULTIPLIER / PRECISION_BOOST_MULTIPLIER>(possibleCollisions) :
-				tsbInvestigator.isClear<-MOLDING_TOLERANCE_MULTIPLIER>(possibleCollisions)))) {
+		if (!sDone && tsbInvestigator.isClear<-Tolerances::TOLERANCE>(possibleCollisions)) {
 #ifdef _RM_DEBUG
 			// Check that algorithms agree:
 			geometry::IntervalList l;
@@ -365,38 +503,31 @@ namespace counting {
 #endif
 			geometry::IntervalList full;
 			full.push_back(geometry::Interval(-MAX_ANGLE_RADIANS, MAX_ANGLE_RADIANS));
-			SS->insert(smlI, full);
+			out.S->insert(smlI - out.offset, full);
 			sDone = true;
 		}
 		if (!mDone && tsbInvestigator.isClear<0>(possibleCollisions)) {
 			geometry::IntervalList full;
 			full.push_back(geometry::Interval(-MAX_ANGLE_RADIANS, MAX_ANGLE_RADIANS));
-			MM->insert(smlI, full);
+			out.M->insert(smlI - out.offset, full);
 			mDone = true;
 		}
-		if (!lDone && (singleFreeAngle ? tsbInvestigator.isClear<EPSILON_TOLERANCE_MULTIPLIER>(possibleCollisions) :
-			(boostPrecision ? tsbInvestigator.isClear<MOLDING_TOLERANCE_MULTIPLIER / PRECISION_BOOST_MULTIPLIER>(possibleCollisions) :
-				tsbInvestigator.isClear<MOLDING_TOLERANCE_MULTIPLIER>(possibleCollisions)))) {
+		if (!lDone && tsbInvestigator.isClear<Tolerances::TOLERANCE>(possibleCollisions)) {
 			geometry::IntervalList full;
 			full.push_back(geometry::Interval(-MAX_ANGLE_RADIANS, MAX_ANGLE_RADIANS));
-			LL->insert(smlI, full);
+			out.L->insert(smlI - out.offset, full);
 			lDone = true;
 		}
 		if (sDone && mDone && lDone) {
-			++boosts[2];
+			++out.boosts[2];
 			return;
 		}
 
 		// Check using TSB:
 		if (!sDone) {
 			geometry::IntervalList l;
-			if (singleFreeAngle)
-				tsbInvestigator.allowableAnglesForBricks<-EPSILON_TOLERANCE_MULTIPLIER>(possibleCollisions, l);
-			else if (boostPrecision)
-				tsbInvestigator.allowableAnglesForBricks<-MOLDING_TOLERANCE_MULTIPLIER / 2>(possibleCollisions, l);
-			else
-				tsbInvestigator.allowableAnglesForBricks<-MOLDING_TOLERANCE_MULTIPLIER>(possibleCollisions, l);
-			SS->insert(smlI, l);
+			tsbInvestigator.allowableAnglesForBricks<-Tolerances::INTERVAL_TOLERANCE>(possibleCollisions, l);
+			out.S->insert(smlI - out.offset, l);
 
 #ifdef _RM_DEBUG
 			//std::cout << smlI << ": " << l << std::endl;
@@ -469,33 +600,492 @@ namespace counting {
 		if (!mDone) {
 			geometry::IntervalList l;
 			tsbInvestigator.allowableAnglesForBricks<0>(possibleCollisions, l);
-			MM->insert(smlI, l);
+			out.M->insert(smlI - out.offset, l);
 		}
 		if (!lDone) {
 			geometry::IntervalList l;
-			if (singleFreeAngle)
-				tsbInvestigator.allowableAnglesForBricks<EPSILON_TOLERANCE_MULTIPLIER>(possibleCollisions, l);
-			else if (boostPrecision)
-				tsbInvestigator.allowableAnglesForBricks<MOLDING_TOLERANCE_MULTIPLIER / 2>(possibleCollisions, l);
-			else
-				tsbInvestigator.allowableAnglesForBricks<MOLDING_TOLERANCE_MULTIPLIER>(possibleCollisions, l);
-			LL->insert(smlI, l);
+			tsbInvestigator.allowableAnglesForBricks<Tolerances::INTERVAL_TOLERANCE>(possibleCollisions, l);
+			out.L->insert(smlI - out.offset, l);
+		}
+		out.boosts[CLICK_CACHE_HITS] += tsbInvestigator.clickCacheHits;
+		out.boosts[CLICK_CACHE_MISSES] += tsbInvestigator.clickCacheMisses;
+		++out.boosts[3];
+	}
+
+	/*
+	Evaluates steps first to end-1 of angle angleI (relative to gridFirst) from coarse to fine:
+	A box of steps is certified clear in S, M or L if the block turning through all of the steps intersects none of the possible collisions.
+	Steps in certified boxes are not checked using isRealizable. Other boxes are split in two until they have at most SML_LEAF_STEPS steps.
+	Since certification only skips checks which would succeed, the result is the same as when evaluating all steps.
+	*/
+	template <typename Tolerances>
+	void AngleMapping::evalSMLSteps(unsigned int angleI, uint32_t smlI, unsigned short first, unsigned short end, Model &c, const BlockPlacement &placement, const util::TinyVector<int, 5> &possibleCollisions, const BrickSoA &collisionBricks, bool noS, bool noM, bool noL, bool clearS, bool clearM, bool clearL, SMLSlice &out) {
+		if (end - first > SML_LEAF_STEPS) {
+			const IConnectionPoint &ip1 = points[2 * angleI];
+			const IConnectionPoint &ip2 = points[2 * angleI + 1];
+			unsigned int ip2I = ip2.first.modelBlockI;
+			const IConnectionPair icp(ip1, ip2);
+			TurningBlockInvestigator tsbInvestigator(c, blocks[ip2I], ip2I, icp);
+
+			const unsigned short d = angleSteps[angleI] == 0 ? 1 : angleSteps[angleI];
+			const double minAngle = StepAngle((short)(gridFirst[angleI] + first) - (short)angleSteps[angleI], d).toRadians();
+			const double maxAngle = StepAngle((short)(gridFirst[angleI] + end - 1) - (short)angleSteps[angleI], d).toRadians();
+			if (!noS && !clearS) {
+				clearS = tsbInvestigator.isClear<-Tolerances::TOLERANCE>(possibleCollisions, minAngle, maxAngle);
+			}
+			if (!noM && !clearM) {
+				clearM = tsbInvestigator.isClear<0>(possibleCollisions, minAngle, maxAngle);
+			}
+			if (!noL && !clearL) {
+				clearL = tsbInvestigator.isClear<Tolerances::TOLERANCE>(possibleCollisions, minAngle, maxAngle);
+			}
+			if (!((noS || clearS) && (noM || clearM) && (noL || clearL))) {
+				const unsigned short mid = (first + end) / 2;
+				evalSMLSteps<Tolerances>(angleI, smlI, first, mid, c, placement, possibleCollisions, collisionBricks, noS, noM, noL, clearS, clearM, clearL, out);
+				evalSMLSteps<Tolerances>(angleI, smlI, mid, end, c, placement, possibleCollisions, collisionBricks, noS, noM, noL, clearS, clearM, clearL, out);
+				return;
+			}
+		}
+
+		for (unsigned short i = first; i < end; ++i) {
+			evalSMLStep<Tolerances>(angleI, smlI + i, gridFirst[angleI] + i, c, placement, collisionBricks, noS, noM, noL, clearS, clearM, clearL, out);
+		}
+	}
+
+	/*
+	Evaluates the SML matrix for a single step of angle angleI.
+	clearS, clearM and clearL indicate that the step has been certified clear by evalSMLSteps().
+	The block of angle angleI is pushed onto c at the angle of the step, and popped again before returning.
+	*/
+	template <typename Tolerances>
+	void AngleMapping::evalSMLStep(unsigned int angleI, uint32_t smlI, unsigned short step, Model &c, const BlockPlacement &placement, const BrickSoA &collisionBricks, bool noS, bool noM, bool noL, bool clearS, bool clearM, bool clearL, SMLSlice &out) {
+		const IConnectionPoint &ip2 = points[2 * angleI + 1];
+		unsigned int ip2I = ip2.first.modelBlockI;
+		const StepAngle angle((short)step - (short)angleSteps[angleI], angleSteps[angleI] == 0 ? 1 : angleSteps[angleI]);
+		c.push(blocks[ip2I], placement, angle.toRadians());
+		bool realizableS = !noS && !clearS, realizableM = !noM && !clearM, realizableL = !noL && !clearL;
+		isRealizableSML<Tolerances>(c, ip2I, collisionBricks, realizableS, realizableM, realizableL);
+		bool noS2 = noS || (!clearS && !realizableS);
+		bool noM2 = noM || (!clearM && !realizableM);
+		bool noL2 = noL || (!clearL && !realizableL);
+		if (noS2 && noM2 && noL2)
+			insertEmptySubMatrix(angleI + 1, smlI, out);
+		else if (angleI == numAngles - 2 && (lastAngleIndependent || (!unreachable.empty() && unreachable[step - gridFirst[0]])))
+			evalSMLIndependent<Tolerances>(smlI, c, noS2, noM2, noL2, out);
+		else
+			evalSML<Tolerances>(angleI + 1, smlI, c, noS2, noM2, noL2, out);
+		c.pop(blocks[ip2I]);
+	}
+
+	/*
+	S, M and L tolerances of isRealizable() for the block at blockI in c. See Model::isRealizableSML().
+	*/
+	template <typename Tolerances>
+	void AngleMapping::isRealizableSML(const Model &c, unsigned int blockI, const BrickSoA &collisionBricks, bool &s, bool &m, bool &l) const {
+		c.isRealizableSML<Tolerances::TOLERANCE>(collisionBricks, blocks[blockI].size, s, m, l);
+	}
+
+	/*
+	Two free angles form a robot arm: The second block turns around the first connection (A) and the last block around the second connection (B).
+	The last block is covered by a circle which turns around B, while the bricks of the first block are covered by their bounding circles.
+	For each step of the first angle, TwinJointRobotArmMotionAnalyzer finds the angles of the last block where the circles overlap.
+	If none of these are within the turning range of the last angle, then the step can not reach the first block.
+	*/
+	void AngleMapping::findUnreachableSteps(const Model &c) {
+		unreachable.clear();
+		if (numAngles != 2 || lastAngleIndependent || angleTypes[0] == 0 || angleTypes[1] == 0)
+			return;
+		const IConnectionPoint &ip1 = points[0];
+		const IConnectionPoint &ip2 = points[1];
+		const IConnectionPoint &ip3 = points[2];
+		const IConnectionPoint &ip4 = points[3];
+		const unsigned int block1 = ip2.first.modelBlockI;
+		const unsigned int block2 = ip4.first.modelBlockI;
+		if (ip3.first.modelBlockI != (int)block1)
+			return; // Both blocks turn around the first block.
+
+		// Arm at the rectilinear angles:
+		const Model c1 = getModel(c, 0, angleSteps[0]);
+		const Model c2 = getModel(c1, 1, angleSteps[1]);
+		const geometry::Point A = Brick(c.origBricks[ip1.first.modelBlockI], ip1.second.brick).getStudPosition(ip1.second.type);
+		const geometry::Point B = Brick(c1.origBricks[block1], ip3.second.brick).getStudPosition(ip3.second.type);
+
+		// Bounding circle of the last block:
+		geometry::Point C(0, 0);
+		const int firstBrickOfBlock2 = c2.bricksSize - blocks[block2].size;
+		for (int i = firstBrickOfBlock2; i < c2.bricksSize; ++i) {
+			C.X += c2.bricks[i].b.center.X / blocks[block2].size;
+			C.Y += c2.bricks[i].b.center.Y / blocks[block2].size;
+		}
+		double radiusC = 0;
+		for (int i = firstBrickOfBlock2; i < c2.bricksSize; ++i)
+			radiusC = MAX(radiusC, geometry::dist(C, c2.bricks[i].b.center));
+		radiusC += BRICK_HALF_DIAGONAL + BRICK_BOUNDING_MARGIN;
+
+		const geometry::Point AB(B.X - A.X, B.Y - A.Y);
+		const geometry::Point BC(C.X - B.X, C.Y - B.Y);
+		const double angleAB = geometry::angleOfPoint(AB);
+		const double angleBC = geometry::angleOfPoint(BC) - angleAB;
+		const geometry::RadianInterval turnBC(geometry::normalizeAngle(angleBC - MAX_ANGLE_RADIANS - EPSILON), geometry::normalizeAngle(angleBC + MAX_ANGLE_RADIANS + EPSILON));
+
+		// Restrictions from the bricks of the first block which the last block can collide with:
+		util::TinyVector<int, 5> possibleCollisions;
+		c1.getPossibleCollisions(blocks[block2], IConnectionPair(ip3, ip4), possibleCollisions);
+		geometry::TwinJointRobotArmMotionAnalyzer analyzer(geometry::norm(AB), geometry::norm(BC));
+		geometry::AngleRestrictorFunctionList restrictions;
+		for (const int* it = possibleCollisions.begin(); it != possibleCollisions.end(); ++it) {
+			if (*it >= blocks[0].size)
+				continue; // Brick of the second block.
+			const geometry::Point &E = c1.bricks[*it].b.center;
+			analyzer.analyzePointToCircle(geometry::Point(E.X - A.X, E.Y - A.Y), radiusC + BRICK_HALF_DIAGONAL + BRICK_BOUNDING_MARGIN, true, restrictions);
+		}
+
+		unsigned int numUnreachable = 0;
+		unreachable.resize(gridSize[0]);
+		for (unsigned short i = 0; i < gridSize[0]; ++i) {
+			const StepAngle angle((short)(gridFirst[0] + i) - (short)angleSteps[0], angleSteps[0]);
+			const double a = geometry::normalizeAngle(angleAB + angle.toRadians());
+			bool reachable = false;
+			for (geometry::AngleRestrictorFunctionList::const_iterator it = restrictions.begin(); !reachable && it != restrictions.end(); ++it) {
+				if (!geometry::inRadianInterval(a, it->primaryInterval))
+					continue;
+				geometry::IntervalList overlap;
+				geometry::intervalAndRadians(it->restrictionFunction(a), turnBC, overlap);
+				reachable = !overlap.empty();
+			}
+			unreachable[i] = !reachable;
+			if (!reachable)
+				++numUnreachable;
+		}
+		if (numUnreachable == 0)
+			unreachable.clear();
+	}
+
+	/*
+	Length of the chain of rigid segments from the pivot of angle angleI to p on block blockI: Each segment goes from one pivot to the next pivot on the way to blockI.
+	Turning angles between the pivot and blockI does not change the segments, so p is never further away from the pivot.
+	*/
+	double AngleMapping::chainLength(unsigned int angleI, unsigned int blockI, const geometry::Point &p, const geometry::Point *pivots) const {
+		// Pivots from blockI up to the block turned by angleI:
+		double length = 0;
+		geometry::Point prev = p;
+		unsigned int b = blockI;
+		while (true) {
+			unsigned int parentAngle = 0;
+			while (points[2 * parentAngle + 1].first.modelBlockI != (int)b)
+				++parentAngle;
+			length += geometry::dist(prev, pivots[parentAngle]);
+			if (parentAngle == angleI)
+				return length;
+			prev = pivots[parentAngle];
+			b = points[2 * parentAngle].first.modelBlockI;
+		}
+	}
+
+	/*
+	Angles turning independent parts of the model need not be evaluated together.
+	The last block is independent of the other angles if it can only reach the block it is connected to:
+	Turning angle k moves a point at most 2*sin(MAX_ANGLE_RADIANS/2) times its chain length to the pivot of angle k.
+	Two bricks can not reach each other if the distance between them at the rectilinear angles exceeds their bounding circles and the moves of all angles turning one but not the other.
+	Bricks on levels further than one apart never collide.
+	*/
+	bool AngleMapping::isLastAngleIndependent() const {
+		if (numAngles < 2)
+			return false;
+		const unsigned int lastBlock = points[2 * numAngles - 1].first.modelBlockI;
+		const unsigned int parentBlock = points[2 * numAngles - 2].first.modelBlockI;
+
+		// Model and pivots at the rectilinear angles:
+		Model c(blocks[0]);
+		geometry::Point pivots[5];
+		for (unsigned int i = 0; i < numAngles; ++i) {
+			const IConnectionPoint &ip1 = points[2 * i];
+			pivots[i] = Brick(c.origBricks[ip1.first.modelBlockI], ip1.second.brick).getStudPosition(ip1.second.type);
+			c = getModel(c, i, angleSteps[i]);
+		}
+
+		// Blocks turned by each angle:
+		bool turnedBy[5][6];
+		for (unsigned int i = 0; i < numAngles; ++i) {
+			for (unsigned int b = 0; b <= numAngles; ++b)
+				turnedBy[i][b] = false;
+			turnedBy[i][points[2 * i + 1].first.modelBlockI] = true;
+		}
+		for (unsigned int i = 0; i < numAngles; ++i) { // The block connected to by angle i is added by an angle before i.
+			for (unsigned int j = 0; j < i; ++j) {
+				if (turnedBy[j][points[2 * i].first.modelBlockI])
+					turnedBy[j][points[2 * i + 1].first.modelBlockI] = true;
+			}
+		}
+
+		const double moveFactor = 2 * sin(MAX_ANGLE_RADIANS / 2);
+		for (int i = 0; i < c.bricksSize; ++i) {
+			const IBrick &ib = c.bricks[i];
+			const unsigned int b = ib.bi.modelBlockI;
+			if (b == lastBlock || b == parentBlock)
+				continue;
+			for (int j = 0; j < c.bricksSize; ++j) {
+				const IBrick &jb = c.bricks[j];
+				if (jb.bi.modelBlockI != (int)lastBlock || ib.b.level > jb.b.level + 1 || jb.b.level > ib.b.level + 1)
+					continue;
+				double maxMove = 0;
+				for (unsigned int k = 0; k < numAngles; ++k) {
+					if (angleTypes[k] == 0 || turnedBy[k][b] == turnedBy[k][lastBlock])
+						continue;
+					if (turnedBy[k][b])
+						maxMove += moveFactor * (chainLength(k, b, ib.b.center, pivots) + BRICK_HALF_DIAGONAL + BRICK_BOUNDING_MARGIN);
+					else
+						maxMove += moveFactor * (chainLength(k, lastBlock, jb.b.center, pivots) + BRICK_HALF_DIAGONAL + BRICK_BOUNDING_MARGIN);
+				}
+				if (geometry::dist(ib.b.center, jb.b.center) <= 2 * (BRICK_HALF_DIAGONAL + BRICK_BOUNDING_MARGIN) + maxMove)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+	Evaluates the last angle when it does not depend on the other angles, or reuses an evaluation with the same realizability of the other angles.
+	*/
+	template <typename Tolerances>
+	void AngleMapping::evalSMLIndependent(uint32_t smlI, Model &c, bool noS, bool noM, bool noL, SMLSlice &out) {
+		for (std::vector<LastAngleSML>::const_iterator it = out.lastAngleSML.begin(); it != out.lastAngleSML.end(); ++it) {
+			if (it->noS == noS && it->noM == noM && it->noL == noL) {
+				out.S->insert(smlI - out.offset, it->S);
+				out.M->insert(smlI - out.offset, it->M);
+				out.L->insert(smlI - out.offset, it->L);
+				++out.boosts[it->boost];
+				return;
+			}
+		}
+
+		counter boostsBefore[BOOST_STAGES];
+		for (int i = 0; i < BOOST_STAGES; ++i)
+			boostsBefore[i] = out.boosts[i];
+		evalSML<Tolerances>(numAngles - 1, smlI, c, noS, noM, noL, out);
+
+		LastAngleSML sml;
+		sml.noS = noS;
+		sml.noM = noM;
+		sml.noL = noL;
+		out.S->get(smlI - out.offset, sml.S);
+		out.M->get(smlI - out.offset, sml.M);
+		out.L->get(smlI - out.offset, sml.L);
+		sml.boost = 0;
+		for (int i = 0; i < BOOST_STAGES; ++i) {
+			if (out.boosts[i] != boostsBefore[i])
+				sml.boost = i;
+		}
+		out.lastAngleSML.push_back(sml);
+	}
+
+	/*
+	Sets all locations of the sub matrix at smlI to empty in S, M and L. The sub matrix covers angles angleI and on.
+	*/
+	void AngleMapping::insertEmptySubMatrix(unsigned int angleI, uint32_t smlI, SMLSlice &out) {
+		uint32_t count = 1;
+		for (unsigned int i = angleI; i < numAngles - 1; ++i) {
+			smlI *= gridSize[i];
+			count *= gridSize[i];
+		}
+		out.S->insertEmpty(smlI - out.offset, count);
+		out.M->insertEmpty(smlI - out.offset, count);
+		out.L->insertEmpty(smlI - out.offset, count);
+		out.boosts[0] += count;
+	}
+
+	void SMLStream::add(const geometry::IntervalListVector &S, const geometry::IntervalListVector &M, const geometry::IntervalListVector &L, uint32_t firstLocation) {
+		ufL.addHyperplane(L, firstLocation, &ufM);
+		ufM.addHyperplane(M, firstLocation, &ufS);
+		ufS.addHyperplane(S, firstLocation, NULL);
+		++added;
+	}
+
+	void SMLStream::finish() {
+		ufL.finish(&ufM);
+		ufM.finish(&ufS);
+		ufS.finish(NULL);
+	}
+
+	SMLArena::SMLArena(unsigned int threads) : attempts(0), mirrored(0), bytesAllocated(0), bytesUsed(0), ufCapacity(0), threads(threads) {
+	}
+
+	SMLArena::~SMLArena() {
+		for (std::vector<SMLBuffers*>::iterator it = slices.begin(); it != slices.end(); ++it)
+			delete *it;
+		for (std::vector<MirroredSML*>::iterator it = mirrors.begin(); it != mirrors.end(); ++it)
+			delete *it;
+	}
+
+	void SMLArena::reset(SMLBuffers &buffers, uint32_t indicatorSize) {
+		bytesAllocated += buffers.S.reset(indicatorSize, MAX_LOAD_FACTOR);
+		bytesAllocated += buffers.M.reset(indicatorSize, MAX_LOAD_FACTOR);
+		bytesAllocated += buffers.L.reset(indicatorSize, MAX_LOAD_FACTOR);
+		bytesUsed += buffers.S.sizeBytes() + buffers.M.sizeBytes() + buffers.L.sizeBytes();
+	}
+
+	void SMLArena::resetSlices(unsigned int numThreads, uint32_t sliceSize) {
+		while (slices.size() < numThreads)
+			slices.push_back(new SMLBuffers()); // Deleted in ~SMLArena()
+		for (unsigned int i = 0; i < numThreads; ++i)
+			reset(*slices[i], sliceSize);
+	}
+
+	void SMLArena::resetUnionFinds(unsigned int numAngles, unsigned short const * const gridSize) {
+		++attempts;
+		ufS.reset(numAngles, gridSize, true);
+		ufM.reset(numAngles, gridSize, false);
+		ufL.reset(numAngles, gridSize, false);
+	}
+
+	void SMLArena::finishAttempt() {
+		const size_t capacity = ufS.capacityBytes() + ufM.capacityBytes() + ufL.capacityBytes();
+		if (capacity > ufCapacity) {
+			bytesAllocated += capacity - ufCapacity;
+			ufCapacity = capacity;
+		}
+		bytesUsed += ufS.sizeBytes() + ufM.sizeBytes() + ufL.sizeBytes();
+	}
+
+	const SMLBuffers* SMLArena::findMirror(const std::vector<int> &key) {
+		for (unsigned int i = 0; i < mirrors.size(); ++i) {
+			MirroredSML *m = mirrors[i];
+			if (m->key != key)
+				continue;
+			// Found: Make it the oldest, so that it is reused by the next call to keepMirror():
+			m->key.clear();
+			mirrors.erase(mirrors.begin() + i);
+			mirrors.insert(mirrors.begin(), m);
+			++mirrored;
+			return &m->sml;
+		}
+		return NULL;
+	}
+
+	void SMLArena::keepMirror(const std::vector<int> &key, const SMLBuffers &sml) {
+		MirroredSML *m;
+		if (mirrors.size() < SML_MIRROR_CACHE_SIZE) {
+			m = new MirroredSML(); // Deleted in ~SMLArena()
+		}
+		else {
+			m = mirrors.front();
+			mirrors.erase(mirrors.begin());
+		}
+		m->key = key;
+		const uint32_t indicatorSize = sml.S.sizeIndicator();
+		bytesAllocated += m->sml.S.reset(indicatorSize, MAX_LOAD_FACTOR);
+		bytesAllocated += m->sml.M.reset(indicatorSize, MAX_LOAD_FACTOR);
+		bytesAllocated += m->sml.L.reset(indicatorSize, MAX_LOAD_FACTOR);
+		m->sml.S.append(0, sml.S);
+		m->sml.M.append(0, sml.M);
+		m->sml.L.append(0, sml.L);
+		mirrors.push_back(m);
+	}
+
+	/*
+	Evaluates the SML matrix on multiple threads: Each step of the first angle is a hyperplane of the SML matrix.
+	Hyperplanes are evaluated into local storage and then added to the union-find structures in order,
+	so only the hyperplanes being evaluated are kept in memory.
+	*/
+	template <typename Tolerances>
+	void AngleMapping::evalSMLSlices(const Model &c, SMLStream &stream) {
+		const IConnectionPoint &ip1 = points[0];
+		const IConnectionPoint &ip2 = points[1];
+		util::TinyVector<int, 5> possibleCollisions;
+		c.getSweptPossibleCollisions(blocks[ip2.first.modelBlockI], IConnectionPair(ip1, ip2), possibleCollisions);
+		BrickSoA collisionBricks;
+		c.getCollisionBricks(possibleCollisions, collisionBricks);
+		BlockPlacement placement;
+		c.getBlockPlacement(ip2.first.modelBlockI, IConnectionPair(ip1, ip2), placement);
+
+		unsigned int numThreads = arena.threads;
+		if (numThreads == 0)
+			numThreads = MAX(1u, std::thread::hardware_concurrency());
+		const unsigned int steps = gridSize[0];
+
+		numThreads = MIN(numThreads, steps);
+		arena.resetSlices(numThreads, sizeMappings / steps);
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < numThreads; ++i) {
+			threads.push_back(std::thread(&AngleMapping::evalSMLSliceWorker<Tolerances>, this, &c, &placement, &collisionBricks, arena.slices[i], &stream));
+		}
+		evalSMLSliceWorker<Tolerances>(&c, &placement, &collisionBricks, arena.slices[0], &stream);
+		for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it) {
+			it->join();
+		}
+	}
+
+	template <typename Tolerances>
+	void AngleMapping::evalSMLSliceWorker(const Model *baseModel, const BlockPlacement *placement, const BrickSoA *collisionBricks, SMLBuffers *buffers, SMLStream *stream) {
+		Model c(*baseModel); // Blocks are pushed onto the model, so each thread has its own.
+		const unsigned int steps = gridSize[0];
+		const uint32_t sliceSize = sizeMappings / steps;
+		geometry::IntervalListVector &S = buffers->S, &M = buffers->M, &L = buffers->L;
+		counter sliceBoosts[BOOST_COUNTERS] = { 0 };
+		SMLSlice out(&S, &M, &L, 0, sliceBoosts);
+
+		unsigned int i;
+		while ((i = stream->next++) < steps) {
+			S.clear();
+			M.clear();
+			L.clear();
+			out.offset = i * sliceSize;
+			evalSMLStep<Tolerances>(0, i, gridFirst[0] + i, c, *placement, *collisionBricks, false, false, false, false, false, false, out);
+
+			// Wait for the preceding hyperplanes to be added:
+			std::unique_lock<std::mutex> lock(stream->mutex);
+			while (stream->added != i)
+				stream->turn.wait(lock);
+			stream->add(S, M, L, 0);
+			stream->turn.notify_all();
+		}
+
+		std::lock_guard<std::mutex> lock(stream->mutex);
+		for (int j = 0; j < BOOST_COUNTERS; ++j) {
+			boosts[j] += sliceBoosts[j];
 		}
-		++boosts[3];
 	}
 
+	/*
+	Islands are assembled in a single pass over the roots of each union-find structure:
+	Each L-root is mapped to its M-root, and each M-root to its S-root. Each M-island is encoded once.
+	*/
 	void AngleMapping::findIslands(std::vector<SIsland> &sIslands, bool &anyProblematic, const util::IntervalUnionFind &ufS, const util::IntervalUnionFind &ufM, const util::IntervalUnionFind &ufL) {
 		// Add all S-islands:
 		for (std::vector<uint32_t>::const_iterator it = ufS.rootsBegin(); it != ufS.rootsEnd(); ++it) {
 			const uint32_t unionI = *it;
 			MixedPosition rep;
 			ufS.getRepresentativeOfUnion(unionI, rep);
+			sIslands.push_back(SIsland(this, unionI, rep, ufS));
+		}
 
-			assert(ufS.getRootForPosition(rep) == unionI);
-			SIsland sIsland(this, unionI, rep, ufS, ufM, ufL);
+		// Count the L-islands of each M-island and keep the representative of the first:
+		const uint32_t numMRoots = ufM.numRoots();
+		std::vector<int> lIslands(numMRoots, 0);
+		std::vector<MixedPosition> lReps(numMRoots);
+		for (std::vector<uint32_t>::const_iterator it = ufL.rootsBegin(); it != ufL.rootsEnd(); ++it) {
+			MixedPosition rep;
+			ufL.getRepresentativeOfUnion(*it, rep);
+			const uint32_t mI = ufM.getIndexOfRoot(ufM.getRootForPosition(rep));
+			if (lIslands[mI]++ == 0)
+				lReps[mI] = rep;
+		}
+
+		// Add all M-islands to their S-islands:
+		uint32_t mI = 0;
+		for (std::vector<uint32_t>::const_iterator it = ufM.rootsBegin(); it != ufM.rootsEnd(); ++it, ++mI) {
+			const uint32_t unionI = *it;
+			MixedPosition rep;
+			ufM.getRepresentativeOfUnion(unionI, rep);
+			MIsland mIsland(this, unionI, rep, lIslands[mI], lReps[mI], ufM);
+			sIslands[ufS.getIndexOfRoot(ufS.getRootForPosition(rep))].mIslands.push_back(mIsland);
+		}
+
+		for (std::vector<SIsland>::const_iterator it = sIslands.begin(); it != sIslands.end(); ++it) {
+			const SIsland &sIsland = *it;
 			if (sIsland.isProblematic())
 				anyProblematic = true;
-			sIslands.push_back(sIsland);
 
 #ifdef _TRACE
 			std::cout << sIsland << std::endl;
@@ -524,6 +1114,63 @@ namespace counting {
 		}
 	}
 
+	/*
+	Problematic S-islands are left for the boosted run, and the region around them is recorded.
+	S-islands within one step of the region are left for the boosted run as well, so that each S-island is counted by exactly one of the runs.
+	*/
+	void AngleMapping::deferProblematicIslands(std::vector<SIsland> &sIslands) {
+		const unsigned int dimensions = numAngles - 1;
+		std::vector<bool> deferred(sIslands.size(), false);
+		hasBoostRegion = false;
+
+		bool anyDeferred = true;
+		while (anyDeferred) {
+			anyDeferred = false;
+			for (unsigned int i = 0; i < sIslands.size(); ++i) {
+				if (deferred[i])
+					continue;
+				const util::UnionBounds &b = sIslands[i].bounds;
+				bool defer = sIslands[i].isProblematic();
+				if (!defer && hasBoostRegion) {
+					defer = true;
+					for (unsigned int j = 0; j < dimensions; ++j) {
+						if (b.min[j] > boostRegionMax[j] + 1 || b.max[j] + 1 < boostRegionMin[j])
+							defer = false;
+					}
+				}
+				if (!defer)
+					continue;
+
+				deferred[i] = anyDeferred = true;
+				for (unsigned int j = 0; j < dimensions; ++j) {
+					boostRegionMin[j] = hasBoostRegion ? MIN(boostRegionMin[j], b.min[j]) : b.min[j];
+					boostRegionMax[j] = hasBoostRegion ? MAX(boostRegionMax[j], b.max[j]) : b.max[j];
+				}
+				hasBoostRegion = true;
+			}
+		}
+
+		std::vector<SIsland> remaining;
+		for (unsigned int i = 0; i < sIslands.size(); ++i) {
+			if (!deferred[i])
+				remaining.push_back(sIslands[i]);
+		}
+		sIslands.swap(remaining);
+	}
+
+	/*
+	True if the bounds of an S-island reach a side of the evaluated grid which is not a side of the full grid.
+	*/
+	bool AngleMapping::atBorderOfGrid(const util::UnionBounds &bounds) const {
+		for (unsigned int i = 0; i < numAngles - 1; ++i) {
+			if (gridFirst[i] > 0 && bounds.min[i] == 0)
+				return true;
+			if (gridFirst[i] + gridSize[i] < 2 * angleSteps[i] + 1 && bounds.max[i] == gridSize[i] - 1)
+				return true;
+		}
+		return false;
+	}
+
 	void AngleMapping::reportProblematic(const MixedPosition &p, int mIslandI, int mIslandTotal, int lIslandTotal, std::vector<util::TinyVector<AngledConnection, 5> > &manual, bool includeMappingFile) const {
 		util::TinyVector<AngledConnection, 5> cc;
 		getModelConnections(p, cc);
@@ -542,8 +1189,9 @@ namespace counting {
 		os << std::endl;
 		os << "  Angles: " << std::endl;
 		for (unsigned int i = 0; i < numAngles - 1; ++i) {
-			double radian = StepAngle(p.p[i] - angleSteps[i], angleSteps[i]).toRadians();
-			os << "   " << (i + 1) << ": step " << p.p[i] << "/" << (2 * angleSteps[i] + 1) << ", fraction " << (p.p[i] - angleSteps[i]) << "/" << angleSteps[i] << ", radian " << radian << std::endl;
+			const int step = p.p[i] + gridFirst[i];
+			double radian = StepAngle(step - angleSteps[i], angleSteps[i]).toRadians();
+			os << "   " << (i + 1) << ": step " << step << "/" << (2 * angleSteps[i] + 1) << ", fraction " << (step - angleSteps[i]) << "/" << angleSteps[i] << ", radian " << radian << std::endl;
 		}
 		os << "   " << numAngles << ": radian " << p.lastAngle << std::endl;
 		if (mIslandTotal > 0)
@@ -564,7 +1212,7 @@ namespace counting {
 		mappingFile.open(mappingFileName.str().c_str(), std::ios::out);
 		mappingFile << numAngles << " ";
 		for (unsigned int i = 0; i < numAngles - 1; ++i)
-			mappingFile << " " << (2 * angleSteps[i] + 1);
+			mappingFile << " " << gridSize[i];
 		mappingFile << std::endl;
 
 		// Print SML Mapping!
@@ -578,7 +1226,7 @@ namespace counting {
 			mappingFile << l << std::endl;
 		}
 		else {
-			for (int i = 0; i < 2 * angleSteps[0] + 1; ++i) {
+			for (int i = 0; i < gridSize[0]; ++i) {
 				geometry::IntervalList s, m, l;
 				SS->get(i, s);
 				MM->get(i, m);
@@ -592,7 +1240,7 @@ namespace counting {
 		mappingFile.close();
 	}
 
-	void AngleMapping::addFoundModel(const Model &c, bool rectilinear, std::set<uint64_t> &nonCyclic, std::set<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear) {
+	void AngleMapping::addFoundModel(const Model &c, bool rectilinear, util::HashSet<uint64_t> &nonCyclic, util::HashSet<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear) {
 		util::TinyVector<IConnectionPair, 8> found;
 		bool checkRealizable = c.isRealizable<-MOLDING_TOLERANCE_MULTIPLIER>(found);
 		if (!checkRealizable) {
@@ -607,8 +1255,7 @@ namespace counting {
 		Encoding encoding = encoder.encode(found);
 
 		if (isCyclic) {
-			if (cyclic.find(encoding) == cyclic.end()) {
-				cyclic.insert(encoding);
+			if (cyclic.insert(encoding)) {
 				if (rectilinear) {
 					newRectilinear.push_back(std::make_pair(c, encoding));
 					++rect;
@@ -622,8 +1269,7 @@ namespace counting {
 			}
 		}
 		else {
-			if (nonCyclic.find(encoding.first) == nonCyclic.end()) {
-				nonCyclic.insert(encoding.first);
+			if (nonCyclic.insert(encoding.first)) {
 				if (rectilinear) {
 					newRectilinear.push_back(std::make_pair(c, encoding));
 					++rect;
@@ -638,13 +1284,13 @@ namespace counting {
 		}
 	}
 
-	void AngleMapping::evalExtremeModels(unsigned int angleI, const Model &c, bool rectilinear, std::set<uint64_t> &nonCyclic, std::set<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear) {
+	void AngleMapping::evalExtremeModels(unsigned int angleI, const Model &c, bool rectilinear, util::HashSet<uint64_t> &nonCyclic, util::HashSet<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear) {
 		// Find possible collisions:
 		const IConnectionPoint &ip1 = points[2 * angleI];
 		const IConnectionPoint &ip2 = points[2 * angleI + 1];
 		unsigned int ip2I = ip2.first.modelBlockI;
 		util::TinyVector<int, 5> possibleCollisions;
-		c.getPossibleCollisions(blocks[ip2I], IConnectionPair(ip1, ip2), possibleCollisions);
+		c.getSweptPossibleCollisions(blocks[ip2I], IConnectionPair(ip1, ip2), possibleCollisions);
 
 		// Recursion:
 		if (angleI + 1 < numAngles) {
@@ -665,7 +1311,7 @@ namespace counting {
 		// End of recursion:
 		assert(angleI == numAngles - 1);
 		const IConnectionPair icp(ip1, ip2);
-		TurningBlockInvestigator tsbInvestigator(c, blocks[ip2I], ip2I, icp);
+		TurningBlockInvestigator tsbInvestigator(c, blocks[ip2I], ip2I, icp, &lastTurningBlock);
 
 		// Speed up for noSML:
 		if (angleTypes[angleI] == 0) {
@@ -687,6 +1333,8 @@ namespace counting {
 		// First go for rectilinear:
 		geometry::IntervalList l;
 		tsbInvestigator.allowableAnglesForBricks<0>(possibleCollisions, l);
+		boosts[CLICK_CACHE_HITS] += tsbInvestigator.clickCacheHits;
+		boosts[CLICK_CACHE_MISSES] += tsbInvestigator.clickCacheMisses;
 		// First check rectilinear:
 		if (rectilinear && geometry::intervalContains(l, 0)) {
 			Model c2 = getModel(c, 0);
@@ -711,7 +1359,7 @@ namespace counting {
 		}
 	}
 
-	void AngleMapping::findNewExtremeModels(std::set<uint64_t> &nonCyclic, std::set<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear) {
+	void AngleMapping::findNewExtremeModels(util::HashSet<uint64_t> &nonCyclic, util::HashSet<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear) {
 		assert(findExtremeAnglesOnly);
 		time_t startTime, endTime;
 		time(&startTime);
@@ -723,52 +1371,74 @@ namespace counting {
 		time(&endTime);
 		double seconds = difftime(endTime, startTime);
 		if (seconds > 2) {
-			std::cout << "Extreme angle finding performed in " << seconds << " seconds for model sizes ";
+			std::stringstream ss;
+			ss << "Extreme angle finding performed in " << seconds << " seconds for model sizes ";
 			for (unsigned int i = 0; i < numAngles + 1; ++i)
-				std::cout << blocks[i].size << " ";
-			std::cout << "indices ";
+				ss << blocks[i].size << " ";
+			ss << "indices ";
 			for (unsigned int i = 0; i < numAngles + 1; ++i)
-				std::cout << blocks[i].index << " ";
-			std::cout << std::endl;
+				ss << blocks[i].index << " ";
+			util::writeLine(ss.str());
 		}
 	}
 
-	void AngleMapping::findNewModels(std::set<uint64_t> &nonCyclic, std::set<Encoding> &cyclic, std::vector<util::TinyVector<AngledConnection, 5> > &manual, std::vector<Model> &modelsToPrint, counter &models, std::vector<std::pair<Model, MIsland> > &newRectilinear, bool stopEarlyIfAnyProblematic, bool &anyProblematic) {
+	void AngleMapping::findNewModels(util::HashSet<uint64_t> &nonCyclic, util::HashSet<Encoding> &cyclic, std::vector<util::TinyVector<AngledConnection, 5> > &manual, std::vector<Model> &modelsToPrint, counter &models, std::vector<std::pair<Model, MIsland> > &newRectilinear, bool deferProblematic, bool &anyProblematic) {
 		assert(!findExtremeAnglesOnly);
 		time_t startTime, endTime;
 		time(&startTime);
 
-		// Compute rectilinear index:
-		rectilinearIndex = numAngles > 1 ? angleSteps[0] : 0;
-		rectilinearPosition.p[0] = angleSteps[0];
-		for (unsigned int i = 1; i < numAngles - 1; ++i) {
-			const int push = 2 * angleSteps[i] + 1;
-			rectilinearIndex = (rectilinearIndex * push) + angleSteps[i];
-			rectilinearPosition.p[i] = angleSteps[i];
+		// Compute rectilinear position:
+		rectilinearInGrid = true;
+		for (unsigned int i = 0; i < numAngles - 1; ++i) {
+			if (angleSteps[i] < gridFirst[i] || angleSteps[i] >= gridFirst[i] + gridSize[i])
+				rectilinearInGrid = false;
+			rectilinearPosition.p[i] = angleSteps[i] - gridFirst[i];
 		}
 		rectilinearPosition.lastAngle = 0;
 
-		// Evaluate SML:
-		Model c(blocks[0]);
-		evalSML(0, 0, c, false, false, false);
-
-		// Evaluate union-find:
-		unsigned short sizes[MAX_DIMENSIONS - 1];
-		for (unsigned int i = 0; i < numAngles - 1; ++i) {
-			sizes[i] = 2 * angleSteps[i] + 1;
+		// Union-find structures, which receive the SML matrix as it is evaluated:
+		arena.resetUnionFinds(numAngles, gridSize);
+		util::IntervalUnionFind &ufS = arena.ufS;
+		util::IntervalUnionFind &ufM = arena.ufM;
+		util::IntervalUnionFind &ufL = arena.ufL;
+		if (rectilinearInGrid)
+			ufM.pin(rectilinearPosition);
+		SMLStream stream(ufS, ufM, ufL);
+
+		// Evaluate SML unless it is the mirror image of that of a previous connection list:
+		std::vector<int> key, mirrorKey;
+		const bool mirrorable = numAngles <= 2 && !boostPrecision;
+		if (mirrorable) {
+			getSymmetryKey(false, key);
+			getSymmetryKey(true, mirrorKey);
+		}
+		const SMLBuffers *mirror = mirrorable ? arena.findMirror(key) : NULL;
+		lastAngleIndependent = isLastAngleIndependent();
+		if (mirror != NULL) {
+			mirrorSMLMatrix(*mirror, stream);
+		}
+		else {
+			Model c(blocks[0]);
+			if (singleFreeAngle)
+				evalSMLMatrix<SingleFreeAngleTolerances>(c, stream);
+			else if (boostPrecision)
+				evalSMLMatrix<BoostedTolerances>(c, stream);
+			else
+				evalSMLMatrix<MoldingTolerances>(c, stream);
+			if (mirrorable && key != mirrorKey) // Not its own mirror image.
+				arena.keepMirror(mirrorKey, arena.sml);
 		}
-		util::IntervalUnionFind ufS(numAngles, sizes, *SS);
-		util::IntervalUnionFind ufM(numAngles, sizes, *MM);
-		util::IntervalUnionFind ufL(numAngles, sizes, *LL);
+		stream.finish();
 
 		// Find islands:
 		std::vector<SIsland> sIslands;
 		anyProblematic = false;
 		findIslands(sIslands, anyProblematic, ufS, ufM, ufL);
+		arena.finishAttempt();
 
-		if (stopEarlyIfAnyProblematic && anyProblematic) {
-			return;
-		}
+		const bool deferred = deferProblematic && anyProblematic;
+		if (deferred)
+			deferProblematicIslands(sIslands);
 
 		/* Perform analysis:
 		Walk through islands in S and report M and L islands.
@@ -778,12 +1448,15 @@ namespace counting {
 		 -- If no L-island. Report problematic. Count 1.
 		 -- If more than one L-island: Report problematic. Still only count 1.
 		*/
-		std::set<uint64_t> newNonCyclic;
-		std::set<Encoding> newCyclic;
 		std::vector<Model> nrcs;
 
 		for (std::vector<SIsland>::const_iterator it = sIslands.begin(); it != sIslands.end(); ++it) {
 			const SIsland &sIsland = *it;
+			if (atBorderOfGrid(sIsland.bounds)) { // Might continue outside of the boosted region => problematic. No count.
+				os << " S-island at the border of the boosted region." << std::endl;
+				reportProblematic(sIsland.representative, 0, 0, 0, manual, true);
+				continue;
+			}
 			if (sIsland.mIslands.size() == 0) { // No M-islands inside => problematic. No count.
 				reportProblematic(sIsland.representative, 0, 0, 0, manual, true);
 				continue;
@@ -795,7 +1468,7 @@ namespace counting {
 				const MIsland &mIsland = *itM;
 
 				Encoding encoding = mIsland.encoding;
-				if (mIsland.isCyclic && cyclic.find(encoding) != cyclic.end())
+				if (mIsland.isCyclic && cyclic.contains(encoding))
 					continue; // Already found. This can happen when there are cycles.
 
 				Model model = getModel(mIsland.representative);
@@ -816,37 +1489,39 @@ namespace counting {
 					++models;
 				}
 
-				if (mIsland.isCyclic) {
-					if (newCyclic.find(encoding) == newCyclic.end())
-						newCyclic.insert(encoding);
-				}
-				else {
-					if (newNonCyclic.find(encoding.first) == newNonCyclic.end())
-						newNonCyclic.insert(encoding.first);
-				}
+				if (mIsland.isCyclic)
+					pendingCyclic.push_back(encoding);
+				else
+					pendingNonCyclic.push_back(encoding.first);
 			}
 		}
 
-		for (std::set<Encoding>::const_iterator it = newCyclic.begin(); it != newCyclic.end(); ++it) {
+		// Added to nonCyclic and cyclic after all islands have been checked, including those of the boosted run:
+		if (deferred)
+			return;
+		for (std::vector<Encoding>::const_iterator it = pendingCyclic.begin(); it != pendingCyclic.end(); ++it) {
 			cyclic.insert(*it);
 		}
-		for (std::set<uint64_t>::const_iterator it = newNonCyclic.begin(); it != newNonCyclic.end(); ++it) {
+		for (std::vector<uint64_t>::const_iterator it = pendingNonCyclic.begin(); it != pendingNonCyclic.end(); ++it) {
 			nonCyclic.insert(*it);
 		}
+		pendingCyclic.clear();
+		pendingNonCyclic.clear();
 
 		time(&endTime);
 		double seconds = difftime(endTime, startTime);
 		if (seconds > 2) {
-			std::cout << "Angle map finding performed in " << seconds << " seconds for model sizes ";
+			std::stringstream ss;
+			ss << "Angle map finding performed in " << seconds << " seconds for model sizes ";
 			for (unsigned int i = 0; i < numAngles + 1; ++i)
-				std::cout << blocks[i].size << " ";
-			std::cout << "indices ";
+				ss << blocks[i].size << " ";
+			ss << "indices ";
 			for (unsigned int i = 0; i < numAngles + 1; ++i)
-				std::cout << blocks[i].index << " ";
-			std::cout << "connections";
+				ss << blocks[i].index << " ";
+			ss << "connections";
 			for (unsigned int i = 0; i < 2 * numAngles; i += 2)
-				std::cout << " " << points[i] << "/" << points[i + 1];
-			std::cout << std::endl;
+				ss << " " << points[i] << "/" << points[i + 1];
+			util::writeLine(ss.str());
 		}
 	}
 }
\ No newline at end of file
@@ -3,21 +3,42 @@
 
 #include <stdint.h>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 #include "../modelling/ConnectionPoint.h"
 #include "../modelling/Model.hpp"
 #include "../modelling/ModelEncoder.h"
+#include "../modelling/TurningSingleBrick.h"
+#include "../geometry/RobotArmMotionPrimitives.h"
 #include "../util/UnionFind.h"
 #include "../util/TinyVector.hpp"
+#include "../util/HashSet.hpp"
 
 #define STEPS_0 0
 #define STEPS_1 203
 #define STEPS_2 370
 #define STEPS_3 538
 #define BOOST_STAGES 4
+// Counters of AngleMappings: The boost stages followed by the hits and misses of the cached click verifications (see TurningBlockInvestigator::isRealizableAtClick()):
+#define CLICK_CACHE_HITS BOOST_STAGES
+#define CLICK_CACHE_MISSES (BOOST_STAGES + 1)
+#define BOOST_COUNTERS (BOOST_STAGES + 2)
 #define MAX_LOAD_FACTOR 4
+// Added to BRICK_HALF_DIAGONAL for the bounding circles of blocks. Covers the click distance (SNAP_DISTANCE) and the tolerances.
+#define BRICK_BOUNDING_MARGIN 0.064
+// Boxes of at most this many steps are not certified clear by evalSMLSteps(), but evaluated step by step.
+#define SML_LEAF_STEPS 16
 // Precision boost multiplier can at most be 60 as UF-structure uses unsigned shorts to manage union-find indices: 65535/(538*2+1) ~= 60.8
 #define PRECISION_BOOST_MULTIPLIER 10
+// Threads used for evaluating the SML matrix when there are at least two step angles. 0 means one per hardware thread.
+// ModelManager uses one thread instead when it runs SingleModelManagers on multiple threads.
+#ifndef SML_THREADS
+#define SML_THREADS 0
+#endif
+// SML matrices kept for the mirror images of their connection lists (see SMLArena::findMirror()):
+#define SML_MIRROR_CACHE_SIZE 256
 
 namespace geometry {
 	void intervalToArray(const geometry::IntervalList &l, bool *array, unsigned int sizeArray);
@@ -31,6 +52,111 @@ namespace counting {
 
 	using namespace modelling;
 
+	/*
+	S, M and L of the last angle when it does not depend on the other angles, and the boost stage used for computing them.
+	*/
+	struct LastAngleSML {
+		bool noS, noM, noL;
+		geometry::IntervalList S, M, L;
+		int boost;
+	};
+
+	/*
+	Tolerances used when evaluating the SML matrix. evalSML() and its callees are instantiated once for each of the modes below, and findNewModels() chooses the mode once:
+	- TOLERANCE: S, M and L are the models realizable with tolerances -TOLERANCE, 0 and TOLERANCE (see Model::isRealizableSML() and TurningBlockInvestigator::isClear()).
+	- INTERVAL_TOLERANCE: Tolerances -INTERVAL_TOLERANCE and INTERVAL_TOLERANCE of the intervals of S and L (see TurningBlockInvestigator::allowableAnglesForBricks()).
+	*/
+	template <int ADD_XY, int INTERVAL_ADD_XY>
+	struct SMLTolerances {
+		static const int TOLERANCE = ADD_XY;
+		static const int INTERVAL_TOLERANCE = INTERVAL_ADD_XY;
+	};
+	// A single free angle, with or without boosted precision:
+	typedef SMLTolerances<EPSILON_TOLERANCE_MULTIPLIER, EPSILON_TOLERANCE_MULTIPLIER> SingleFreeAngleTolerances;
+	typedef SMLTolerances<MOLDING_TOLERANCE_MULTIPLIER / PRECISION_BOOST_MULTIPLIER, MOLDING_TOLERANCE_MULTIPLIER / 2> BoostedTolerances;
+	typedef SMLTolerances<MOLDING_TOLERANCE_MULTIPLIER, MOLDING_TOLERANCE_MULTIPLIER> MoldingTolerances;
+
+	/*
+	Target of evalSML: Locations in S, M and L are smlI-offset.
+	lastAngleSML holds the evaluations of the last angle which can be reused (see evalSMLIndependent()).
+	*/
+	struct SMLSlice {
+		geometry::IntervalListVector *S, *M, *L;
+		uint32_t offset;
+		counter *boosts;
+		std::vector<LastAngleSML> lastAngleSML;
+
+		SMLSlice(geometry::IntervalListVector *S, geometry::IntervalListVector *M, geometry::IntervalListVector *L, uint32_t offset, counter *boosts) : S(S), M(M), L(L), offset(offset), boosts(boosts) {
+		}
+	};
+
+	/*
+	Hyperplanes of the SML matrix (steps of the first angle) are added to the union-find structures in order:
+	L before M before S, as representatives of L-islands are pinned in M, and those of M-islands in S.
+	next and added are used when the hyperplanes are evaluated on multiple threads.
+	*/
+	struct SMLStream {
+		util::IntervalUnionFind &ufS, &ufM, &ufL;
+		std::atomic<unsigned int> next; // Next hyperplane to evaluate.
+		unsigned int added; // Hyperplanes added to the union-find structures.
+		std::mutex mutex;
+		std::condition_variable turn;
+
+		SMLStream(util::IntervalUnionFind &ufS, util::IntervalUnionFind &ufM, util::IntervalUnionFind &ufL) : ufS(ufS), ufM(ufM), ufL(ufL), next(0), added(0) {
+		}
+
+		void add(const geometry::IntervalListVector &S, const geometry::IntervalListVector &M, const geometry::IntervalListVector &L, uint32_t firstLocation);
+		void finish();
+	};
+
+	// S, M and L of the SML matrix or of a slice of it:
+	struct SMLBuffers {
+		geometry::IntervalListVector S, M, L;
+
+		SMLBuffers() : S(0, MAX_LOAD_FACTOR), M(0, MAX_LOAD_FACTOR), L(0, MAX_LOAD_FACTOR) {
+		}
+	};
+
+	/*
+	S, M and L of a connection list with at most 2 angles, kept until the mirror image of the connection list is investigated.
+	key is the symmetry key of the mirror image (see AngleMapping::getSymmetryKey()).
+	*/
+	struct MirroredSML {
+		std::vector<int> key;
+		SMLBuffers sml;
+	};
+
+	/*
+	Buffers of the SML matrix and the union-find structures, which are reused by one AngleMapping after another.
+	Buffers are kept at their high-water-mark size, so only attempts needing more memory than any previous attempt allocate.
+	An arena must only be used by one AngleMapping at a time.
+	bytesUsed is what the attempts would have allocated without the arena. bytesAllocated is what they allocated.
+	The arena also keeps the SML matrices of the last connection lists for their mirror images. mirrored counts the attempts which used one.
+	*/
+	struct SMLArena {
+		SMLBuffers sml; // Full SML matrix for at most 2 angles.
+		std::vector<SMLBuffers*> slices; // One for each thread of evalSMLSlices(). Deleted in ~SMLArena().
+		std::vector<MirroredSML*> mirrors; // At most SML_MIRROR_CACHE_SIZE. Oldest first. Deleted in ~SMLArena().
+		util::IntervalUnionFind ufS, ufM, ufL;
+		counter attempts, mirrored, bytesAllocated, bytesUsed;
+		size_t ufCapacity; // Bytes held by the union-find structures after the last attempt.
+		unsigned int threads; // Threads of evalSMLSlices(). 0 means one per hardware thread.
+
+		SMLArena(unsigned int threads);
+		~SMLArena();
+
+		void reset(SMLBuffers &buffers, uint32_t indicatorSize);
+		void resetSlices(unsigned int numThreads, uint32_t sliceSize);
+		void resetUnionFinds(unsigned int numAngles, unsigned short const * const gridSize);
+		void finishAttempt(); // Accounts for the memory of the union-find structures once the attempt is done with them.
+		/*
+		Returns the kept SML matrix stored for key, or NULL if there is none.
+		Each kept matrix is only found once: It is reused by the next call to keepMirror().
+		*/
+		const SMLBuffers* findMirror(const std::vector<int> &key);
+		void keepMirror(const std::vector<int> &key, const SMLBuffers &sml);
+	};
+
 	/*
 	Mapping angles (See README):
 	Size 0 => Granularity 0 - 0 => 1 step.
@@ -43,26 +169,41 @@ namespace counting {
 		unsigned int numAngles, numBricks; //, numBlock = numAngles+1;
 		uint32_t sizeMappings;
 		FatBlock blocks[6];
-		geometry::IntervalListVector *SS, *MM, *LL;
+		geometry::IntervalListVector *SS, *MM, *LL; // Only for at most 2 angles. Otherwise the SML matrix is streamed one hyperplane at a time. Owned by the arena.
 
 		IConnectionPoint points[10];
 		unsigned int angleTypes[5]; // Connection(aka. angle) -> 0, 1, 2, or 3.
 		unsigned short angleSteps[5]; // Connection(aka. angle) -> 1, 203, 370, or 538.
+		unsigned short gridFirst[MAX_DIMENSIONS - 1], gridSize[MAX_DIMENSIONS - 1]; // Evaluated part of the SML grid: Steps gridFirst[i] to gridFirst[i]+gridSize[i]-1 of angle i.
 		const ModelEncoder &encoder;
-		uint32_t rectilinearIndex;
+		SMLArena &arena;
 		MixedPosition rectilinearPosition;
-		counter boosts[BOOST_STAGES];
+		bool rectilinearInGrid;
+		counter boosts[BOOST_COUNTERS];
 	private:
 		bool singleFreeAngle, findExtremeAnglesOnly;
-		std::ofstream &os;
+		std::ostream &os;
 		bool boostPrecision;
+		// Region around the S-islands deferred to the boosted run (in steps before boosting):
+		bool hasBoostRegion;
+		unsigned short boostRegionMin[MAX_DIMENSIONS - 1], boostRegionMax[MAX_DIMENSIONS - 1];
+		// Encodings found in the first run, which are added together with those of the boosted run:
+		std::vector<uint64_t> pendingNonCyclic;
+		std::vector<Encoding> pendingCyclic;
+		// If the last block can only reach the block it is connected to, then S, M and L of the last angle do not depend on the other angles.
+		// They are then only evaluated once for each realizability of the other angles (see isLastAngleIndependent()):
+		bool lastAngleIndependent;
+		// Two free angles: Steps of the first angle where the last block can not reach the first block (see findUnreachableSteps()):
+		std::vector<bool> unreachable;
+		// The last block turning about the last connection, used at the end of the recursion for all models (see createLastTurningBlock()):
+		TurningBlockCache lastTurningBlock;
 
 	public:
-		AngleMapping(FatBlock const * const blocks, int numBlock, const util::TinyVector<IConnectionPair, 5> &cs, const ModelEncoder &encoder, std::ofstream &os, bool findExtremeAnglesOnly);
+		AngleMapping(FatBlock const * const blocks, int numBlock, const util::TinyVector<IConnectionPair, 5> &cs, const ModelEncoder &encoder, SMLArena &arena, std::ostream &os, bool findExtremeAnglesOnly);
 		AngleMapping& operator=(const AngleMapping &tmp) {
 			assert(false); // Assignment operator should not be used.
 			util::TinyVector<IConnectionPair, 5> cs;
-			AngleMapping *ret = new AngleMapping(NULL, 0, cs, tmp.encoder, tmp.os, false); // Not deleted - fails.
+			AngleMapping *ret = new AngleMapping(NULL, 0, cs, tmp.encoder, tmp.arena, tmp.os, false); // Not deleted - fails.
 			return *ret;
 		}
 		~AngleMapping();
@@ -70,19 +211,46 @@ namespace counting {
 		/*
 		1) For all possible angles: Comput S,M,L.
 		2) Combine regions in S,M,L in order to determine new models.
+		If deferProblematic, then problematic S-islands are left for a boosted run, which only evaluates the region around them.
 		*/
-		void findNewModels(std::set<uint64_t> &nonCyclic, std::set<Encoding> &cyclic, std::vector<util::TinyVector<AngledConnection, 5> > &manual, std::vector<Model> &modelsToPrint, counter &models, std::vector<std::pair<Model, MIsland> > &newRectilinear, bool stopEarlyIfAnyProblematic, bool &anyProblematic);
-		void findNewExtremeModels(std::set<uint64_t> &nonCyclic, std::set<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear);
+		void findNewModels(util::HashSet<uint64_t> &nonCyclic, util::HashSet<Encoding> &cyclic, std::vector<util::TinyVector<AngledConnection, 5> > &manual, std::vector<Model> &modelsToPrint, counter &models, std::vector<std::pair<Model, MIsland> > &newRectilinear, bool deferProblematic, bool &anyProblematic);
+		void findNewExtremeModels(util::HashSet<uint64_t> &nonCyclic, util::HashSet<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear);
 		Model getModel(const MixedPosition &p) const;
 		void setBoostPrecision();
 
 	private:
 		void reportProblematic(const MixedPosition &p, int mIslandI, int mIslandTotal, int lIslandTotal, std::vector<util::TinyVector<AngledConnection, 5> > &manual, bool includeMappingFile) const;
-		void addFoundModel(const Model &c, bool rectilinear, std::set<uint64_t> &nonCyclic, std::set<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear);
-		void evalExtremeModels(unsigned int angleI, const Model &c, bool rectilinear, std::set<uint64_t> &nonCyclic, std::set<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear);
-		void evalSML(unsigned int angleI, uint32_t smlIndex, const Model &c, bool noS, bool noM, bool noL);
+		void addFoundModel(const Model &c, bool rectilinear, util::HashSet<uint64_t> &nonCyclic, util::HashSet<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear);
+		void evalExtremeModels(unsigned int angleI, const Model &c, bool rectilinear, util::HashSet<uint64_t> &nonCyclic, util::HashSet<Encoding> &cyclic, std::vector<Model> &modelsToPrint, counter &models, counter &rect, std::vector<std::pair<Model, Encoding> > &newRectilinear);
+		template <typename Tolerances>
+		void evalSMLMatrix(Model &c, SMLStream &stream);
+		void mirrorSMLMatrix(const SMLBuffers &mirror, SMLStream &stream);
+		void getSymmetryKey(bool mirrored, std::vector<int> &key) const;
+		template <typename Tolerances>
+		void evalSML(unsigned int angleI, uint32_t smlIndex, Model &c, bool noS, bool noM, bool noL, SMLSlice &out);
+		template <typename Tolerances>
+		void evalSMLSteps(unsigned int angleI, uint32_t smlIndex, unsigned short first, unsigned short end, Model &c, const BlockPlacement &placement, const util::TinyVector<int, 5> &possibleCollisions, const BrickSoA &collisionBricks, bool noS, bool noM, bool noL, bool clearS, bool clearM, bool clearL, SMLSlice &out);
+		template <typename Tolerances>
+		void evalSMLStep(unsigned int angleI, uint32_t smlIndex, unsigned short step, Model &c, const BlockPlacement &placement, const BrickSoA &collisionBricks, bool noS, bool noM, bool noL, bool clearS, bool clearM, bool clearL, SMLSlice &out);
+		void insertEmptySubMatrix(unsigned int angleI, uint32_t smlIndex, SMLSlice &out);
+		template <typename Tolerances>
+		void isRealizableSML(const Model &c, unsigned int blockI, const BrickSoA &collisionBricks, bool &s, bool &m, bool &l) const;
+		bool isLastAngleIndependent() const;
+		double chainLength(unsigned int angleI, unsigned int blockI, const geometry::Point &p, const geometry::Point *pivots) const;
+		void findUnreachableSteps(const Model &c);
+		template <typename Tolerances>
+		void evalSMLIndependent(uint32_t smlIndex, Model &c, bool noS, bool noM, bool noL, SMLSlice &out);
+		template <typename Tolerances>
+		void evalSMLSlices(const Model &c, SMLStream &stream);
+		template <typename Tolerances>
+		void evalSMLSliceWorker(const Model *baseModel, const BlockPlacement *placement, const BrickSoA *collisionBricks, SMLBuffers *buffers, SMLStream *stream);
 		void findIslands(std::vector<SIsland> &sIslands, bool &anyProblematic, const util::IntervalUnionFind &ufS, const util::IntervalUnionFind &ufM, const util::IntervalUnionFind &ufL);
+		void deferProblematicIslands(std::vector<SIsland> &sIslands);
+		bool atBorderOfGrid(const util::UnionBounds &bounds) const;
 		void setupAngleTypes();
+		void createLastTurningBlock();
+		template <typename Tolerances>
+		void createLastTurningBlock(const FatBlock &block, const ConnectionPoint &point);
 		Model getModel(const Model &baseModel, double lastAngle) const;
 		Model getModel(const Model &baseModel, int angleI, unsigned short angleStep) const;
 		void getModelConnections(const MixedPosition &p, util::TinyVector<AngledConnection, 5> &result) const;
@@ -96,47 +264,31 @@ namespace counting {
 		MixedPosition representative;
 		Encoding encoding;
 
-		MIsland(AngleMapping *a, uint32_t unionFindIndex, const MixedPosition &p, Encoding encoding, bool isCyclic, const util::IntervalUnionFind &ufM, const util::IntervalUnionFind &ufL) : lIslands(0), isRectilinear(false), isCyclic(isCyclic), sizeRep(a->numAngles), representative(p), encoding(encoding) {
+		/*
+		lIslands is the number of L-islands in the M-island, and lRep is the representative of the first of them.
+		The M-island is encoded using the rectilinear position if it is in the M-island, otherwise using lRep if there are L-islands, and otherwise using p.
+		*/
+		MIsland(AngleMapping *a, uint32_t unionFindIndex, const MixedPosition &p, int lIslands, const MixedPosition &lRep, const util::IntervalUnionFind &ufM) : lIslands(lIslands), isRectilinear(false), sizeRep(a->numAngles), representative(p) {
 			assert(unionFindIndex == ufM.getRootForPosition(p));
-			bool encodingUpdated = false;
-			geometry::IntervalList rectilinearList;
-			a->MM->get(a->rectilinearIndex, rectilinearList);
-			isRectilinear = geometry::intervalContains(rectilinearList, 0) && ufM.getRootForPosition(a->rectilinearPosition) == unionFindIndex;
+			isRectilinear = a->rectilinearInGrid && ufM.contains(a->rectilinearPosition) && ufM.getRootForPosition(a->rectilinearPosition) == unionFindIndex;
 			if (isRectilinear) {
-				// Update members to ensure correct encoding:
-				util::TinyVector<IConnectionPair, 8> found;
-				a->getModel(a->rectilinearPosition).isRealizable<-MOLDING_TOLERANCE_MULTIPLIER>(found);
-				this->encoding = a->encoder.encode(found);
-				this->isCyclic = found.size() > a->numAngles;
-				this->representative = a->rectilinearPosition;
-				encodingUpdated = true;
+				representative = a->rectilinearPosition;
 #ifdef _TRACE
 				std::cout << "Encoding updated for rectilinear position!" << std::endl;
 #endif
 			}
-
-			// Add all L-islands:
-			for (std::vector<uint32_t>::const_iterator it = ufL.rootsBegin(); it != ufL.rootsEnd(); ++it) {
-				const uint32_t unionI = *it;
-				MixedPosition rep;
-				ufL.getRepresentativeOfUnion(unionI, rep);
-				if (ufM.getRootForPosition(rep) == unionFindIndex) {
-					if (!encodingUpdated) {
-						// Update members to ensure correct encoding:
-						util::TinyVector<IConnectionPair, 8> found;
-						a->getModel(rep).isRealizable<-MOLDING_TOLERANCE_MULTIPLIER>(found);
-						this->encoding = a->encoder.encode(found);
-						this->isCyclic = found.size() > a->numAngles;
-						this->representative = rep;
-						encodingUpdated = true;
+			else if (lIslands > 0) {
+				representative = lRep;
 #ifdef _TRACE
-						std::cout << "Encoding updated!" << std::endl;
+				std::cout << "Encoding updated!" << std::endl;
 #endif
-					}
-
-					++lIslands;
-				}
 			}
+
+			// Encode the representative:
+			util::TinyVector<IConnectionPair, 8> found;
+			a->getModel(representative).isRealizable<-MOLDING_TOLERANCE_MULTIPLIER>(found);
+			encoding = a->encoder.encode(found);
+			isCyclic = found.size() > a->numAngles;
 		}
 		MIsland() {}
 		MIsland(const MIsland &l) : lIslands(l.lIslands), isRectilinear(l.isRectilinear), isCyclic(l.isCyclic), sizeRep(l.sizeRep), representative(l.representative), encoding(l.encoding) {}
@@ -146,8 +298,9 @@ namespace counting {
 		std::vector<MIsland> mIslands;
 		unsigned int sizeRep;
 		MixedPosition representative;
+		util::UnionBounds bounds;
 
-		bool isProblematic() {
+		bool isProblematic() const {
 			if (mIslands.size() != 1)
 				return true;
 			for (std::vector<MIsland>::const_iterator it = mIslands.begin(); it != mIslands.end(); ++it) {
@@ -157,28 +310,14 @@ namespace counting {
 			return false;
 		}
 
-		SIsland(AngleMapping *a, uint32_t unionFindIndex, const MixedPosition &p, const util::IntervalUnionFind &ufS, const util::IntervalUnionFind &ufM, const util::IntervalUnionFind &ufL) : sizeRep(a->numAngles), representative(p) {
+		/*
+		M-islands are added by AngleMapping::findIslands().
+		*/
+		SIsland(AngleMapping *a, uint32_t unionFindIndex, const MixedPosition &p, const util::IntervalUnionFind &ufS) : sizeRep(a->numAngles), representative(p), bounds(ufS.getBoundsOfUnion(unionFindIndex)) {
 			assert(unionFindIndex == ufS.getRootForPosition(p));
-			// Add all M-islands:
-			for (std::vector<uint32_t>::const_iterator it = ufM.rootsBegin(); it != ufM.rootsEnd(); ++it) {
-				const uint32_t unionI = *it;
-				MixedPosition rep;
-				ufM.getRepresentativeOfUnion(unionI, rep);
-
-				Model c = a->getModel(rep);
-				util::TinyVector<IConnectionPair, 8> found;
-				c.isRealizable<-MOLDING_TOLERANCE_MULTIPLIER>(found);
-				bool isCyclic = found.size() > a->numAngles;
-				Encoding encoding = a->encoder.encode(found);
-
-				if (ufS.getRootForPosition(rep) == unionFindIndex) {
-					MIsland mIsland(a, unionI, rep, encoding, isCyclic, ufM, ufL);
-					mIslands.push_back(mIsland);
-				}
-			}
 		}
 		SIsland() {}
-		SIsland(const SIsland &l) : mIslands(l.mIslands), sizeRep(l.sizeRep), representative(l.representative) {}
+		SIsland(const SIsland &l) : mIslands(l.mIslands), sizeRep(l.sizeRep), representative(l.representative), bounds(l.bounds) {}
 	};
 }
 inline std::ostream& operator<<(std::ostream &os, const counting::MIsland& m) {
@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <algorithm>
+#include <sstream>
+#include <thread>
 #include <time.h>
 
 #include "BlockManager.h"
@@ -10,60 +12,9 @@
 namespace counting {
 	void ModelManager::runForCombination(const util::TinyVector<FatBlock, 6> &combination, const util::TinyVector<int, 6> &combinationType, int prevBlockIndex, std::ofstream &os) {
 		if (combination.size() == combinationType.size()) {
-
-			pw.reportProgress();
-			SingleModelManager mgr(combination, os, findExtremeAnglesOnly);
-			mgr.run();
-
-			attempts += mgr.attempts;
-			rectilinear += mgr.rectilinear;
-			models += mgr.models;
-			problematic += mgr.manual.size();
-			for (int i = 0; i < BOOST_STAGES; ++i) {
-				angleMappingBoosts[i] += mgr.angleMappingBoosts[i];
-			}
-
-#ifdef _DEBUG
-			//    mgr.printMPDFile();
-#endif
-
-#ifdef _COMPARE_ALGORITHMS
-			if (correct.empty()) {
-				return;
-			}
-			std::cout << "Removing " << mgr.foundBlocks.size() << " from " << correct.size() << std::endl;
-			for (std::map<FatBlock, uint64_t>::const_iterator it = mgr.foundBlocks.begin(); it != mgr.foundBlocks.end(); ++it) {
-				const FatBlock &block = it->first;
-				if (correct.find(block) == correct.end()) {
-					std::cout << "Incorrectly found: " << block << std::endl;
-					MPDPrinter h, d, d2;
-					h.add("IncorrectlyFound", new Model(block)); // new OK as we are done.
-					h.print("IncorrectlyFound");
-
-					for (std::map<FatBlock, uint64_t>::const_iterator it2 = mgr.foundBlocks.begin(); it2 != mgr.foundBlocks.end(); ++it2) {
-						const FatBlock &block2 = it2->first;
-						std::stringstream ss;
-						ss << "all" << it2->second;
-						d.add(ss.str(), new Model(block2)); // new OK as we are done.
-					}
-					d.print("AllInIncorrectBatch");
-
-					int i = 0;
-					for (std::set<FatBlock>::const_iterator it2 = correct.begin(); it2 != correct.end() && i < 9; ++it2, ++i) {
-						const FatBlock &block2 = *it2;
-						std::stringstream ss;
-						ss << "correct_" << i;
-						d2.add(ss.str(), new Model(block2)); // new OK as we are done.
-					}
-					d2.print("FirstCorrect");
-
-					assert(false); std::cerr << "DIE X429" << std::endl;
-					int *die = NULL; die[0] = 42;
-				}
-				correct.erase(block);
-			}
-#endif
-
+			batch.push_back(CombinationResult(combination));
+			if (batch.size() >= COMBINATION_BATCH_SIZE)
+				runBatch(os);
 			return;
 		}
 
@@ -78,6 +29,101 @@ namespace counting {
 		}
 	}
 
+	/*
+	Runs the SingleModelManagers of the batch on all threads. Threads take the next combination of the batch until none are left.
+	Results are added in the order of the batch, so the manual file and totals do not depend on the number of threads.
+	With more than one thread, the SingleModelManagers evaluate SML matrices on a single thread rather than starting threads of their own.
+	*/
+	void ModelManager::runBatch(std::ofstream &os) {
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < numThreads && i < batch.size(); ++i) {
+			threads.push_back(std::thread(&ModelManager::runBatchWorker, this, &next));
+		}
+		runBatchWorker(&next);
+		for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it) {
+			it->join();
+		}
+
+		for (std::vector<CombinationResult>::const_iterator it = batch.begin(); it != batch.end(); ++it) {
+			addResult(*it, os);
+		}
+		batch.clear();
+	}
+
+	void ModelManager::runBatchWorker(std::atomic<size_t> *next) {
+		size_t i;
+		while ((i = (*next)++) < batch.size()) {
+			CombinationResult &result = batch[i];
+			std::stringstream ss;
+			SingleModelManager mgr(result.combination, ss, findExtremeAnglesOnly, numThreads > 1 ? 1 : SML_THREADS);
+			mgr.run();
+
+			result.attempts = mgr.attempts;
+			result.rectilinear = mgr.rectilinear;
+			result.models = mgr.models;
+			result.problematic = mgr.manual.size();
+			for (int j = 0; j < BOOST_COUNTERS; ++j) {
+				result.angleMappingBoosts[j] = mgr.angleMappingBoosts[j];
+			}
+			result.manualOutput = ss.str();
+#ifdef _COMPARE_ALGORITHMS
+			result.foundBlocks = mgr.foundBlocks;
+#endif
+
+			std::lock_guard<std::mutex> lock(progressMutex); // Progress is reported for each combination, as it is done.
+			pw.reportProgress();
+		}
+	}
+
+	void ModelManager::addResult(const CombinationResult &result, std::ofstream &os) {
+		os << result.manualOutput;
+		attempts += result.attempts;
+		rectilinear += result.rectilinear;
+		models += result.models;
+		problematic += result.problematic;
+		for (int i = 0; i < BOOST_COUNTERS; ++i) {
+			angleMappingBoosts[i] += result.angleMappingBoosts[i];
+		}
+
+#ifdef _COMPARE_ALGORITHMS
+		if (correct.empty()) {
+			return;
+		}
+		std::cout << "Removing " << result.foundBlocks.size() << " from " << correct.size() << std::endl;
+		for (std::map<FatBlock, uint64_t>::const_iterator it = result.foundBlocks.begin(); it != result.foundBlocks.end(); ++it) {
+			const FatBlock &block = it->first;
+			if (correct.find(block) == correct.end()) {
+				std::cout << "Incorrectly found: " << block << std::endl;
+				MPDPrinter h, d, d2;
+				h.add("IncorrectlyFound", new Model(block)); // new OK as we are done.
+				h.print("IncorrectlyFound");
+
+				for (std::map<FatBlock, uint64_t>::const_iterator it2 = result.foundBlocks.begin(); it2 != result.foundBlocks.end(); ++it2) {
+					const FatBlock &block2 = it2->first;
+					std::stringstream ss;
+					ss << "all" << it2->second;
+					d.add(ss.str(), new Model(block2)); // new OK as we are done.
+				}
+				d.print("AllInIncorrectBatch");
+
+				int i = 0;
+				for (std::set<FatBlock>::const_iterator it2 = correct.begin(); it2 != correct.end() && i < 9; ++it2, ++i) {
+					const FatBlock &block2 = *it2;
+					std::stringstream ss;
+					ss << "correct_" << i;
+					d2.add(ss.str(), new Model(block2)); // new OK as we are done.
+				}
+				d2.print("FirstCorrect");
+
+				assert(false); std::cerr << "DIE X429" << std::endl;
+				int *die = NULL; die[0] = 42;
+			}
+			correct.erase(block);
+		}
+#endif
+	}
+
 	void ModelManager::runForCombinationType(const util::TinyVector<int, 6> &combinationType, int combinedSize) {
 #ifdef _COMPARE_ALGORITHMS
 		RectilinearModelManager blockMgr;
@@ -131,6 +177,7 @@ namespace counting {
 			v.push_back(blocks[firstBlockSize - 1][i]);
 			runForCombination(v, combinationType, i, os);
 		}
+		runBatch(os);
 
 		os.flush();
 		os.close();
@@ -164,6 +211,7 @@ namespace counting {
 		for (int i = 0; i < BOOST_STAGES; ++i) {
 			std::cout << "  BOOST LEVEL " << (i + 1) << ": " << angleMappingBoosts[i] << std::endl;
 		}
+		std::cout << "  Click verifications reused: " << angleMappingBoosts[CLICK_CACHE_HITS] << " of " << (angleMappingBoosts[CLICK_CACHE_HITS] + angleMappingBoosts[CLICK_CACHE_MISSES]) << std::endl;
 		std::cout << " Remaining Rectilinear Blocks to find:       " << correct.size() << std::endl;
 		std::cout << std::endl;
 		// Print unseen:
@@ -235,6 +283,7 @@ namespace counting {
 		for (int i = 0; i < BOOST_STAGES; ++i) {
 			std::cout << "  BOOST LEVEL " << (i + 1) << ": " << angleMappingBoosts[i] << std::endl;
 		}
+		std::cout << "  Click verifications reused: " << angleMappingBoosts[CLICK_CACHE_HITS] << " of " << (angleMappingBoosts[CLICK_CACHE_HITS] + angleMappingBoosts[CLICK_CACHE_MISSES]) << std::endl;
 #endif
 #ifdef _COMPARE_ALGORITHMS
 		std::cout << " Remaining Rectilinear Blocks to find:       " << correct.size() << std::endl;
@@ -253,8 +302,10 @@ namespace counting {
 		std::cout << std::endl;
 	}
 
-	ModelManager::ModelManager(int maxBlockSize, bool findExtremeAnglesOnly) : attempts(0), rectilinear(0), models(0), problematic(0), findExtremeAnglesOnly(findExtremeAnglesOnly) {
-		for (int i = 0; i < BOOST_STAGES; ++i) {
+	ModelManager::ModelManager(int maxBlockSize, bool findExtremeAnglesOnly) : attempts(0), rectilinear(0), models(0), problematic(0), findExtremeAnglesOnly(findExtremeAnglesOnly), numThreads(MODEL_MANAGER_THREADS) {
+		if (numThreads == 0)
+			numThreads = MAX(1u, std::thread::hardware_concurrency());
+		for (int i = 0; i < BOOST_COUNTERS; ++i) {
 			angleMappingBoosts[i] = 0;
 		}
 		RectilinearModelManager blockMgr;
@@ -288,15 +339,15 @@ namespace counting {
 		encoder.decode(encoded, list);
 
 		std::vector<AngledConnection> cs;
-		for (std::set<IConnectionPair>::const_iterator it2 = list.begin(); it2 != list.end(); ++it2) {
+		for (const IConnectionPair* it2 = list.begin(); it2 != list.end(); ++it2) {
 			cs.push_back(AngledConnection(*it2, StepAngle()));
 			listx.push_back(*it2);
 			std::cout << *it2 << std::endl;
 		}
 
-		std::vector<IConnectionPoint> pool;
-		SingleModelManager singleMgr(v2, os, false);
-		singleMgr.run(listx, pool, pool, NULL, 0, false);
+		ConnectionPointPool pool;
+		SingleModelManager singleMgr(v2, os, false, SML_THREADS);
+		singleMgr.run(listx, pool, pool, NULL, 0);
 		singleMgr.printManualLDRFiles();
 		singleMgr.printMPDFile();
 
@@ -312,7 +363,7 @@ namespace counting {
 		pairs.push_back(IConnectionPair(icp1,icp2));
 
 		SingleModelManager sm(v2, os, false);
-		std::vector<IConnectionPoint> pools;
+		ConnectionPointPool pools;
 		sm.run(pairs, pools, pools, NULL, 0);
 		sm.printMPDFile();
 		sm.printManualLDRFiles();
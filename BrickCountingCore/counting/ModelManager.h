@@ -1,23 +1,58 @@
 #ifndef COUNTING_MODEL_MANAGER_H
 #define COUNTING_MODEL_MANAGER_H
 
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "../modelling/Block.hpp"
 #include "SingleModelManager.h"
 
+// Number of combinations handed to the worker threads at a time. Output of a batch is kept in memory until the batch is done.
+#define COMBINATION_BATCH_SIZE 4096
+// Number of threads running SingleModelManagers. 0 means one per hardware thread. With more than one, each SingleModelManager evaluates SML matrices on one thread.
+#ifndef MODEL_MANAGER_THREADS
+#define MODEL_MANAGER_THREADS 0
+#endif
+
 using namespace modelling;
 
 namespace counting {
+	/*
+	Result of running a SingleModelManager for a combination in a batch.
+	The manual output is buffered so that it can be written in the order of the combinations.
+	*/
+	struct CombinationResult {
+		util::TinyVector<FatBlock, 6> combination;
+		counter attempts, rectilinear, models, problematic;
+		counter angleMappingBoosts[BOOST_COUNTERS];
+		std::string manualOutput;
+#ifdef _COMPARE_ALGORITHMS
+		std::map<FatBlock, uint64_t> foundBlocks;
+#endif
+
+		CombinationResult(const util::TinyVector<FatBlock, 6> &combination) : combination(combination), attempts(0), rectilinear(0), models(0), problematic(0) {
+		}
+	};
+
 	class ModelManager {
 	private:
 		FatBlock* blocks[5];
 		unsigned long blocksSize[5];
 
 		counter attempts, rectilinear, models, problematic;
-		counter angleMappingBoosts[BOOST_STAGES];
+		counter angleMappingBoosts[BOOST_COUNTERS];
 		bool findExtremeAnglesOnly;
 		util::ProgressWriter pw;
+		std::mutex progressMutex; // Guards pw, which the worker threads report to.
+		unsigned int numThreads;
+		std::vector<CombinationResult> batch;
 
 		void runForCombination(const util::TinyVector<FatBlock, 6> &combination, const util::TinyVector<int, 6> &combinationType, int prevBlockIndex, std::ofstream &os);
+		void runBatch(std::ofstream &os);
+		void runBatchWorker(std::atomic<size_t> *next);
+		void addResult(const CombinationResult &result, std::ofstream &os);
 
 		void runForCombinationType(const util::TinyVector<int, 6> &combinationType, int remaining, int prevSize, int combinedSize);
 	public:
@@ -9,9 +9,9 @@
 #include "../util/MPDPrinter.h"
 
 namespace counting {
-	SingleModelManager::SingleModelManager(const util::TinyVector<FatBlock, 6> &combination, std::ofstream &os, bool findExtremeAnglesOnly) :
-		combinationSize((unsigned int)combination.size()), encoder(combination), os(os), findExtremeAnglesOnly(findExtremeAnglesOnly), attempts(0), models(0), rectilinear(0) {
-		for (int i = 0; i < BOOST_STAGES; ++i) {
+	SingleModelManager::SingleModelManager(const util::TinyVector<FatBlock, 6> &combination, std::ostream &os, bool findExtremeAnglesOnly, unsigned int smlThreads) :
+		combinationSize((unsigned int)combination.size()), encoder(combination), arena(smlThreads), os(os), findExtremeAnglesOnly(findExtremeAnglesOnly), attempts(0), models(0), rectilinear(0) {
+		for (int i = 0; i < BOOST_COUNTERS; ++i) {
 			angleMappingBoosts[i] = 0;
 		}
 		std::stringstream ss;
@@ -36,28 +36,12 @@ namespace counting {
 			this->combination[i] = combination[i];
 
 			// Get all above and below:
-			combination[i].getConnectionPoints(above[i], below[i]);
-		}
-	}
-
-	void mergePools(std::vector<IConnectionPoint> &newPool, const std::vector<IConnectionPoint> &oldPool, const std::vector<IConnectionPoint>::const_iterator &itIgnoreFromOld,
-		const std::set<ConnectionPoint> &newElements, unsigned long newBlockI, int newModelBlockI) {
-		for (std::vector<IConnectionPoint>::const_iterator it = oldPool.begin(); it != oldPool.end(); ++it) {
-			if (it != itIgnoreFromOld)
-				newPool.push_back(*it);
-		}
-		for (std::set<ConnectionPoint>::const_iterator it = newElements.begin(); it != newElements.end(); ++it) {
-			newPool.push_back(IConnectionPoint(BrickIdentifier(newBlockI, it->brickI, newModelBlockI), *it));
-		}
-	}
-
-	void mergePools(std::vector<IConnectionPoint> &newPool, const std::vector<IConnectionPoint> &oldPool, const std::set<ConnectionPoint>::const_iterator &itIgnoreFromNew, const std::set<ConnectionPoint> &newElements, unsigned long newBlockI, int newModelBlockI) {
-		for (std::vector<IConnectionPoint>::const_iterator it = oldPool.begin(); it != oldPool.end(); ++it) {
-			newPool.push_back(*it);
-		}
-		for (std::set<ConnectionPoint>::const_iterator it = newElements.begin(); it != newElements.end(); ++it) {
-			if (it != itIgnoreFromNew)
-				newPool.push_back(IConnectionPoint(BrickIdentifier(newBlockI, it->brickI, newModelBlockI), *it));
+			std::set<ConnectionPoint> aboveSet, belowSet;
+			combination[i].getConnectionPoints(aboveSet, belowSet);
+			for (std::set<ConnectionPoint>::const_iterator it = aboveSet.begin(); it != aboveSet.end(); ++it)
+				above[i].push_back(IConnectionPoint(BrickIdentifier(combination[i].index, it->brickI, i), *it));
+			for (std::set<ConnectionPoint>::const_iterator it = belowSet.begin(); it != belowSet.end(); ++it)
+				below[i].push_back(IConnectionPoint(BrickIdentifier(combination[i].index, it->brickI, i), *it));
 		}
 	}
 
@@ -65,7 +49,7 @@ namespace counting {
 		// Find out if IConnectionPairSet created on rotated Block is "smaller":
 		// Step one: Divide ConnectionPoints for the Blocks:
 		util::TinyVector<ConnectionPoint, 5> pointsForBlocks[6];
-		for (std::set<IConnectionPair>::const_iterator it = l.begin(); it != l.end(); ++it) {
+		for (const IConnectionPair* it = l.begin(); it != l.end(); ++it) {
 			const IConnectionPoint &cp1 = it->first;
 			const IConnectionPoint &cp2 = it->second;
 			pointsForBlocks[cp1.first.modelBlockI].push_back(cp1.second);
@@ -81,8 +65,37 @@ namespace counting {
 		return true;
 	}
 
-	void SingleModelManager::run(util::TinyVector<IConnectionPair, 5> &l, const std::vector<IConnectionPoint> &abovePool, const std::vector<IConnectionPoint> &belowPool, bool *remaining, int remainingSize, bool countForPw) {
+	/*
+	Number of connection lists visited by run(l, abovePool, belowPool, remaining, remainingSize).
+	Only the sizes of the pools matter, so this is computed without building any connection lists.
+	Lists that are skipped because they are not rotationally minimal or have been investigated are included.
+	*/
+	uint64_t SingleModelManager::countConnectionLists(unsigned long abovePoolSize, unsigned long belowPoolSize, bool *remaining, int remainingSize) const {
+		if (remainingSize == 0)
+			return 1;
+
+		uint64_t ret = 0;
+		for (unsigned int i = 1; i < combinationSize; ++i) {
+			if (!remaining[i] || (prevMustBeChosen[i] && remaining[i - 1]))
+				continue;
+			remaining[i] = false;
+			const unsigned long aboveI = (unsigned long)above[i].size();
+			const unsigned long belowI = (unsigned long)below[i].size();
+			// All above:
+			if (abovePoolSize > 0 && belowI > 0)
+				ret += abovePoolSize * belowI * countConnectionLists(abovePoolSize - 1 + aboveI, belowPoolSize + belowI - 1, remaining, remainingSize - 1);
+			// All below:
+			if (belowPoolSize > 0 && aboveI > 0)
+				ret += belowPoolSize * aboveI * countConnectionLists(abovePoolSize + aboveI - 1, belowPoolSize - 1 + belowI, remaining, remainingSize - 1);
+			remaining[i] = true;
+		}
+		return ret;
+	}
+
+	void SingleModelManager::run(util::TinyVector<IConnectionPair, 5> &l, ConnectionPointPool &abovePool, ConnectionPointPool &belowPool, bool *remaining, int remainingSize) {
 		if (remainingSize == 0) {
+			pw.reportProgress();
+
 			// First check that we have at least not run this combination before:
 			// If the connections are not even rotationslly minimal, then bail:
 			IConnectionPairSet list;
@@ -93,9 +106,8 @@ namespace counting {
 
 			// If we have already investigated the encoding (without cycles), then bail:
 			uint64_t encoded = encoder.encode(list).first;
-			if (investigatedConnectionPairListsEncoded.find(encoded) != investigatedConnectionPairListsEncoded.end())
+			if (!investigatedConnectionPairListsEncoded.insert(encoded))
 				return;
-			investigatedConnectionPairListsEncoded.insert(encoded);
 
 #ifdef _DEBUG
 			// Report status if combination starts with a single brick Block:
@@ -108,25 +120,22 @@ namespace counting {
 #endif
 
 			++attempts;
-			if (countForPw)
-				return; // Early return for count.
-
 			if (!findExtremeAnglesOnly) {
-				AngleMapping angleMapping(combination, combinationSize, l, encoder, os, findExtremeAnglesOnly);
+				AngleMapping angleMapping(combination, combinationSize, l, encoder, arena, os, findExtremeAnglesOnly);
 
 				std::vector<std::pair<Model, MIsland> > newRectilinear;
 				bool anyProblematic = false;
 				angleMapping.findNewModels(nonCyclicModels, cyclicModels, manual, modelsToPrint, models, newRectilinear, true, anyProblematic);
 				if (anyProblematic) {
-					std::cout << "Problematic models found. Running again with boosted precision!" << std::endl;
+					util::writeLine("Problematic models found. Running again with boosted precision around them!");
 					anyProblematic = false;
 					angleMapping.setBoostPrecision();
-					angleMapping.findNewModels(nonCyclicModels, cyclicModels, manual, modelsToPrint, models, newRectilinear, false, anyProblematic); // Try again with higher precision.
+					angleMapping.findNewModels(nonCyclicModels, cyclicModels, manual, modelsToPrint, models, newRectilinear, false, anyProblematic); // Try again with higher precision around the problematic islands.
 					if (anyProblematic)
-						std::cout << " Problematic models found even with boosted precision!" << std::endl;
+						util::writeLine(" Problematic models found even with boosted precision!");
 				}
 
-				for (int i = 0; i < BOOST_STAGES; ++i) {
+				for (int i = 0; i < BOOST_COUNTERS; ++i) {
 					angleMappingBoosts[i] += angleMapping.boosts[i];
 				}
 				rectilinear += newRectilinear.size();
@@ -187,7 +196,7 @@ namespace counting {
 #endif
 			}
 			else {
-				AngleMapping angleMapping(combination, combinationSize, l, encoder, os, findExtremeAnglesOnly);
+				AngleMapping angleMapping(combination, combinationSize, l, encoder, arena, os, findExtremeAnglesOnly);
 
 				std::vector<std::pair<Model, Encoding> > newRectilinear;
 				angleMapping.findNewExtremeModels(nonCyclicModels, cyclicModels, modelsToPrint, models, rectilinear, newRectilinear);
@@ -214,7 +223,6 @@ namespace counting {
 				}
 #endif
 			}
-			pw.reportProgress();
 
 			return;
 		}
@@ -225,29 +233,43 @@ namespace counting {
 			remaining[i] = false;
 			// Add a connection and recurse:
 			// All above:
-			for (std::vector<IConnectionPoint>::const_iterator it_cp1 = abovePool.begin(); it_cp1 != abovePool.end(); ++it_cp1) {
-				for (std::set<ConnectionPoint>::const_iterator it_cp2 = below[i].begin(); it_cp2 != below[i].end(); ++it_cp2) {
-					IConnectionPoint ip2(BrickIdentifier(combination[i].index, it_cp2->brickI, i), *it_cp2);
-					l.push_back(IConnectionPair(*it_cp1, ip2));
-					std::vector<IConnectionPoint> newAbovePool, newBelowPool;
-					mergePools(newAbovePool, abovePool, it_cp1, above[i], combination[i].index, i);
-					mergePools(newBelowPool, belowPool, it_cp2, below[i], combination[i].index, i);
-					run(l, newAbovePool, newBelowPool, remaining, remainingSize - 1, countForPw);
+			const unsigned int aboveSize = abovePool.size;
+			for (unsigned int j = 0; j < aboveSize; ++j) {
+				if (abovePool.used[j])
+					continue;
+				abovePool.used[j] = true;
+				for (unsigned int k = 0; k < below[i].size(); ++k) {
+					l.push_back(IConnectionPair(abovePool.points[j], below[i][k]));
+					abovePool.push(above[i]);
+					const unsigned int belowStart = belowPool.size;
+					belowPool.push(below[i]);
+					belowPool.used[belowStart + k] = true;
+					run(l, abovePool, belowPool, remaining, remainingSize - 1);
+					belowPool.pop(below[i]);
+					abovePool.pop(above[i]);
 					l.pop_back();
 				}
+				abovePool.used[j] = false;
 			}
 
 			// All below:
-			for (std::vector<IConnectionPoint>::const_iterator it_cp1 = belowPool.begin(); it_cp1 != belowPool.end(); ++it_cp1) {
-				for (std::set<ConnectionPoint>::const_iterator it_cp2 = above[i].begin(); it_cp2 != above[i].end(); ++it_cp2) {
-					IConnectionPoint ip2(BrickIdentifier(combination[i].index, it_cp2->brickI, i), *it_cp2);
-					l.push_back(IConnectionPair(*it_cp1, ip2));
-					std::vector<IConnectionPoint> newAbovePool, newBelowPool;
-					mergePools(newBelowPool, belowPool, it_cp1, below[i], combination[i].index, i);
-					mergePools(newAbovePool, abovePool, it_cp2, above[i], combination[i].index, i);
-					run(l, newAbovePool, newBelowPool, remaining, remainingSize - 1, countForPw);
+			const unsigned int belowSize = belowPool.size;
+			for (unsigned int j = 0; j < belowSize; ++j) {
+				if (belowPool.used[j])
+					continue;
+				belowPool.used[j] = true;
+				for (unsigned int k = 0; k < above[i].size(); ++k) {
+					l.push_back(IConnectionPair(belowPool.points[j], above[i][k]));
+					belowPool.push(below[i]);
+					const unsigned int aboveStart = abovePool.size;
+					abovePool.push(above[i]);
+					abovePool.used[aboveStart + k] = true;
+					run(l, abovePool, belowPool, remaining, remainingSize - 1);
+					abovePool.pop(above[i]);
+					belowPool.pop(below[i]);
 					l.pop_back();
 				}
+				belowPool.used[j] = false;
 			}
 
 			remaining[i] = true;
@@ -255,15 +277,6 @@ namespace counting {
 	}
 
 	void SingleModelManager::run() {
-		run(true);
-		pw.initSteps((unsigned long)attempts);
-		pw.initTime();
-		attempts = 0;
-		investigatedConnectionPairListsEncoded.clear();
-		run(false);
-	}
-
-	void SingleModelManager::run(bool countForPw) {
 		time_t startTime, endTime;
 		time(&startTime);
 
@@ -275,7 +288,7 @@ namespace counting {
 #endif
 
 		// Try all combinations!
-		std::vector<IConnectionPoint> abovePool, belowPool;
+		ConnectionPointPool abovePool, belowPool;
 		util::TinyVector<IConnectionPair, 5> l;
 		bool remaining[6];
 		int remainingSize = combinationSize - 1;
@@ -285,14 +298,14 @@ namespace counting {
 			remaining[i] = true;
 		}
 
-		for (std::set<ConnectionPoint>::const_iterator it = above[0].begin(); it != above[0].end(); ++it)
-			abovePool.push_back(IConnectionPoint(BrickIdentifier(combination[0].index, it->brickI, 0), *it));
-		for (std::set<ConnectionPoint>::const_iterator it = below[0].begin(); it != below[0].end(); ++it)
-			belowPool.push_back(IConnectionPoint(BrickIdentifier(combination[0].index, it->brickI, 0), *it));
+		abovePool.push(above[0]);
+		belowPool.push(below[0]);
 
-		run(l, abovePool, belowPool, remaining, remainingSize, countForPw);
-		if (countForPw)
-			return;
+		// Progress is reported for each connection list, including those skipped as duplicates:
+		pw.initSteps((unsigned long)countConnectionLists(abovePool.size, belowPool.size, remaining, remainingSize));
+		pw.initTime();
+
+		run(l, abovePool, belowPool, remaining, remainingSize);
 		// Print:
 		printManualLDRFiles();
 		printMPDFile();
@@ -300,7 +313,9 @@ namespace counting {
 		double seconds = difftime(endTime, startTime);
 #ifdef _TRACE
 		std::cout << "SingleModelManager::run() INTERNAL RESULTS: " << std::endl;
-		std::cout << " investigatedConnectionPairListsEncoded: " << investigatedConnectionPairListsEncoded.size() << std::endl;
+		std::cout << " investigatedConnectionPairListsEncoded: " << investigatedConnectionPairListsEncoded.size() << " (" << investigatedConnectionPairListsEncoded.memoryUsage() << " bytes)" << std::endl;
+		std::cout << " nonCyclicModels: " << nonCyclicModels.size() << " (" << nonCyclicModels.memoryUsage() << " bytes)" << std::endl;
+		std::cout << " cyclicModels: " << cyclicModels.size() << " (" << cyclicModels.memoryUsage() << " bytes)" << std::endl;
 		std::cout << " foundRectilinearModelsEncoded: " << rectilinear << std::endl;
 		std::cout << " models found: " << models << std::endl;
 
@@ -309,16 +324,21 @@ namespace counting {
 		for (int i = 0; i < BOOST_STAGES; ++i) {
 			std::cout << " BOOST LEVEL " << (i + 1) << ": " << angleMappingBoosts[i] << std::endl;
 		}
+		std::cout << "Click verifications reused: " << angleMappingBoosts[CLICK_CACHE_HITS] << " of " << (angleMappingBoosts[CLICK_CACHE_HITS] + angleMappingBoosts[CLICK_CACHE_MISSES]) << std::endl;
+		std::cout << "SML buffers of " << arena.attempts << " runs of AngleMappings: " << arena.bytesAllocated << " bytes allocated for " << arena.bytesUsed << " bytes used." << std::endl;
+		std::cout << "SML matrices mirrored from previous connection lists: " << arena.mirrored << " of " << arena.attempts << std::endl;
 #endif
 		if (seconds <= 1)
 			return;
-		std::cout << " Single model (sizes";
+		std::stringstream ss;
+		ss << " Single model (sizes";
 		for (unsigned int i = 0; i < combinationSize; ++i)
-			std::cout << " " << combination[i].size;
-		std::cout << ") (indices";
+			ss << " " << combination[i].size;
+		ss << ") (indices";
 		for (unsigned int i = 0; i < combinationSize; ++i)
-			std::cout << " " << combination[i].index;
-		std::cout << ") handled in " << seconds << " seconds." << std::endl;
+			ss << " " << combination[i].index;
+		ss << ") handled in " << seconds << " seconds. Encoding sets use " << (investigatedConnectionPairListsEncoded.memoryUsage() + nonCyclicModels.memoryUsage() + cyclicModels.memoryUsage()) / 1024 << " kB. SML buffers: " << arena.bytesAllocated / 1024 << " kB allocated for " << arena.bytesUsed / 1024 << " kB used.";
+		util::writeLine(ss.str());
 	}
 
 	void SingleModelManager::printMPDFile() const {
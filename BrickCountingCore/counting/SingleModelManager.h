@@ -6,19 +6,51 @@
 #include <map>
 
 #include "../util/ProgressWriter.hpp"
+#include "../util/HashSet.hpp"
 #include "../modelling/Model.hpp"
 #include "../modelling/ConnectionPoint.h"
 #include "../modelling/Block.hpp"
 #include "../modelling/ModelEncoder.h"
 #include "AngleMapping.h"
 
+// At most 4 connection points above and below each brick of a block:
+#define MAX_BLOCK_CONNECTION_POINTS 20
+#define MAX_POOL_CONNECTION_POINTS (6 * MAX_BLOCK_CONNECTION_POINTS)
+
 using namespace modelling;
 
 namespace counting {
+	typedef util::TinyVector<IConnectionPoint, MAX_BLOCK_CONNECTION_POINTS> BlockConnectionPoints;
+
+	/*
+	Connection points available while building connection lists.
+	Points of a block are pushed when the block is connected and popped when the recursion returns.
+	Points that are used by a connection are marked rather than removed, so the order of the pool is kept and nothing is copied.
+	*/
+	struct ConnectionPointPool {
+		IConnectionPoint points[MAX_POOL_CONNECTION_POINTS];
+		bool used[MAX_POOL_CONNECTION_POINTS];
+		unsigned int size;
+
+		ConnectionPointPool() : size(0) {}
+
+		inline void push(const BlockConnectionPoints &v) {
+			assert(size + v.size() <= MAX_POOL_CONNECTION_POINTS);
+			for (const IConnectionPoint* it = v.begin(); it != v.end(); ++it) {
+				points[size] = *it;
+				used[size++] = false;
+			}
+		}
+		inline void pop(const BlockConnectionPoints &v) {
+			assert(size >= v.size());
+			size -= v.size();
+		}
+	};
+
 	class SingleModelManager {
 	public:
-		std::set<uint64_t> nonCyclicModels;
-		std::set<Encoding> cyclicModels;
+		util::HashSet<uint64_t> nonCyclicModels;
+		util::HashSet<Encoding> cyclicModels;
 
 #ifdef _COMPARE_ALGORITHMS
 		std::map<FatBlock, uint64_t> foundBlocks; // For debugging only!
@@ -28,27 +60,28 @@ namespace counting {
 	private:
 		std::vector<Model> nrcToPrint; // Used when there are non-rectilinear models, but not multiple non-rectilinear models for a given connection set.
 		std::vector<Model> modelsToPrint; // Used when there are multiple models for a given connection set then include all models in it - including the RC!
-		std::set<uint64_t> investigatedConnectionPairListsEncoded;
+		util::HashSet<uint64_t> investigatedConnectionPairListsEncoded;
 		unsigned int combinationSize;
 		FatBlock combination[6];
 		ModelEncoder encoder;
-		std::ofstream &os;
+		SMLArena arena; // Buffers reused by the AngleMappings of all attempts.
+		std::ostream &os;
 		util::ProgressWriter pw;
 
 		// Used only for construction:
-		std::set<ConnectionPoint> above[6], below[6];
+		BlockConnectionPoints above[6], below[6];
 		bool prevMustBeChosen[6], findExtremeAnglesOnly;
 
-		void run(bool countForPw);
+		uint64_t countConnectionLists(unsigned long abovePoolSize, unsigned long belowPoolSize, bool *remaining, int remainingSize) const;
 	public: // TODO: Only public for testing.
-		void run(util::TinyVector<IConnectionPair, 5> &l, const std::vector<IConnectionPoint> &abovePool, const std::vector<IConnectionPoint> &belowPool, bool *remaining, int remainingSize, bool countForPw);
+		void run(util::TinyVector<IConnectionPair, 5> &l, ConnectionPointPool &abovePool, ConnectionPointPool &belowPool, bool *remaining, int remainingSize);
 
 	public:
-		SingleModelManager(const util::TinyVector<FatBlock, 6> &combination, std::ofstream &os, bool findExtremeAnglesOnly);
+		SingleModelManager(const util::TinyVector<FatBlock, 6> &combination, std::ostream &os, bool findExtremeAnglesOnly, unsigned int smlThreads);
 		SingleModelManager& operator=(const SingleModelManager &tmp) {
 			assert(false); // Assignment operator should not be used.
 			util::TinyVector<FatBlock, 6> c;
-			SingleModelManager *ret = new SingleModelManager(c, tmp.os, false); // Not deleted - fails on invoce.
+			SingleModelManager *ret = new SingleModelManager(c, tmp.os, false, 1); // Not deleted - fails on invoce.
 			return *ret;
 		}
 
@@ -59,7 +92,7 @@ namespace counting {
 		bool isRotationallyMinimal(const IConnectionPairSet &l) const;
 
 		counter attempts, models, rectilinear;//, nonRectilinearModels, 
-		counter angleMappingBoosts[BOOST_STAGES];
+		counter angleMappingBoosts[BOOST_COUNTERS];
 	};
 }
 
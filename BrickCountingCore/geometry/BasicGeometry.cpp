@@ -535,7 +535,7 @@ namespace geometry {
     }
   }
 
-  IntervalListVector::IntervalListVector() : intervalsSize(0), indicatorSize(0) {
+  IntervalListVector::IntervalListVector() : intervalsSize(0), indicatorSize(0), intervalsCapacity(0), indicatorCapacity(0) {
     assert(false);std::cerr << "DIE DEFAULT CONSTRUCTOR FOR IntervalListVector SHOULD NEVER BE CALLED" << std::endl;
     int *die = NULL; die[0] = 42;
   }
@@ -543,14 +543,36 @@ namespace geometry {
     return *(new IntervalListVector()); // FAILS ON PURPOSE
   }
 
-  IntervalListVector::IntervalListVector(uint32_t indicatorSize, unsigned int maxLoadFactor) : intervalsSize(512+indicatorSize*maxLoadFactor), indicatorSize(indicatorSize), intervalsI(0) {
-    intervals = new Interval[intervalsSize]; // Deleted in ~IntervalListVector()
-    indicators = new IntervalIndicator[indicatorSize]; // Deleted in ~IntervalListVector()
+  IntervalListVector::IntervalListVector(uint32_t indicatorSize, unsigned int maxLoadFactor) : intervalsSize(512+indicatorSize*maxLoadFactor), indicatorSize(indicatorSize), intervalsCapacity(intervalsSize), indicatorCapacity(indicatorSize), intervalsI(0) {
+    intervals = new Interval[intervalsSize]; // Deleted in ~IntervalListVector() or reset()
+    indicators = new IntervalIndicator[indicatorSize]; // Deleted in ~IntervalListVector() or reset()
   }
   IntervalListVector::~IntervalListVector() {
     delete[] intervals;
     delete[] indicators;
   }
+  size_t IntervalListVector::reset(uint32_t indicatorSize, unsigned int maxLoadFactor) {
+    size_t ret = 0;
+    intervalsSize = 512+indicatorSize*maxLoadFactor;
+    this->indicatorSize = indicatorSize;
+    intervalsI = 0;
+    if(intervalsSize > intervalsCapacity) {
+      delete[] intervals;
+      intervalsCapacity = intervalsSize;
+      intervals = new Interval[intervalsCapacity];
+      ret += intervalsCapacity * sizeof(Interval);
+    }
+    if(indicatorSize > indicatorCapacity) {
+      delete[] indicators;
+      indicatorCapacity = indicatorSize;
+      indicators = new IntervalIndicator[indicatorCapacity];
+      ret += indicatorCapacity * sizeof(IntervalIndicator);
+    }
+    return ret;
+  }
+  size_t IntervalListVector::sizeBytes() const {
+    return intervalsSize * sizeof(Interval) + indicatorSize * sizeof(IntervalIndicator);
+  }
   void IntervalListVector::insert(uint32_t location, const IntervalList &intervalList) {
     assert(location < indicatorSize);
     assert(intervalList.size() < 20);
@@ -569,6 +591,30 @@ namespace geometry {
     indicators[location].first = intervalsI;
     indicators[location].second = 0;
   }
+  void IntervalListVector::insertEmpty(uint32_t firstLocation, uint32_t count) {
+    assert(firstLocation + count <= indicatorSize);
+    assert(intervalsI < intervalsSize);
+    for(uint32_t i = firstLocation; i < firstLocation + count; ++i) {
+      indicators[i].first = intervalsI;
+      indicators[i].second = 0;
+    }
+  }
+  void IntervalListVector::append(uint32_t firstLocation, const IntervalListVector &slice) {
+    assert(firstLocation + slice.indicatorSize <= indicatorSize);
+    if(intervalsI + slice.intervalsI > intervalsSize) {
+      assert(false);std::cerr << "DIE X018: " << intervalsI <<"+"<< slice.intervalsI <<">"<< intervalsSize << std::endl;
+      int *die = NULL; die[0] = 42;
+    }
+    for(uint32_t i = 0; i < slice.indicatorSize; ++i) {
+      indicators[firstLocation + i].first = intervalsI + slice.indicators[i].first;
+      indicators[firstLocation + i].second = slice.indicators[i].second;
+    }
+    for(uint32_t i = 0; i < slice.intervalsI; ++i)
+      intervals[intervalsI++] = slice.intervals[i];
+  }
+  void IntervalListVector::clear() {
+    intervalsI = 0;
+  }
   void IntervalListVector::get(uint32_t location, IntervalList &intervalList) const {
     assert(location < indicatorSize);
     uint32_t intervalsIndex = indicators[location].first;
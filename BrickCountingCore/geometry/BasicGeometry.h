@@ -80,15 +80,25 @@ namespace geometry {
 	private:
 		Interval *intervals;
 		IntervalIndicator *indicators;
-		const uint32_t intervalsSize, indicatorSize;
+		uint32_t intervalsSize, indicatorSize;
+		uint32_t intervalsCapacity, indicatorCapacity; // Allocated sizes. Kept by reset() when large enough.
 		uint32_t intervalsI;
 		IntervalListVector(); // Unused
 		IntervalListVector& operator=(const IntervalListVector &); // Unused
 	public:
 		IntervalListVector(uint32_t indicatorSize, unsigned int maxLoadFactor);
 		~IntervalListVector();
+		/*
+		Clears and resizes the vector as if it was constructed again. Memory is only allocated when the new size exceeds the capacity.
+		Returns the number of bytes allocated.
+		*/
+		size_t reset(uint32_t indicatorSize, unsigned int maxLoadFactor);
+		size_t sizeBytes() const; // Bytes needed by a vector of the current size.
 		void insert(uint32_t location, const IntervalList &intervalList);
 		void insertEmpty(uint32_t location);
+		void insertEmpty(uint32_t firstLocation, uint32_t count); // Locations firstLocation to firstLocation+count-1 are set to empty.
+		void append(uint32_t firstLocation, const IntervalListVector &slice); // Copies all locations of slice to firstLocation and on.
+		void clear();
 		void get(uint32_t location, IntervalList &intervalList) const;
 		Interval get(uint32_t location, unsigned short intervalIndex) const;
 		uint32_t sizeIndicator() const;
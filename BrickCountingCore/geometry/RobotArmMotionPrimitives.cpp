@@ -1,9 +1,115 @@
 #include "RobotArmMotionPrimitives.h"
 
+#include "../Common.h"
+
 namespace geometry {
+	Function::Function() : ab(0), bc(0), Ey(0), r(0), rotation(0), restrictBGivenA(true) {}
+	Function::Function(double ab, double bc, double Ey, double r, double rotation, bool restrictBGivenA) : ab(ab), bc(bc), Ey(Ey), r(r), rotation(rotation), restrictBGivenA(restrictBGivenA) {}
+
+	RadianInterval Function::operator()(double angle) const {
+		if (restrictBGivenA) {
+			// C moves on the circle around B. Find the arc inside E:
+			const double a = angle + rotation;
+			const Point EB(-ab*cos(a), Ey - ab*sin(a));
+			const double d = norm(EB);
+			if (d + bc <= r || bc < EPSILON || d < EPSILON)
+				return RadianInterval(-M_PI, M_PI);
+			double cosAlpha = (bc*bc + d*d - r*r) / (2 * bc*d);
+			cosAlpha = MAX(-1.0, MIN(1.0, cosAlpha));
+			const double alpha = acos(cosAlpha);
+			const double phi = angleOfPoint(EB);
+			return RadianInterval(normalizeAngle(phi - alpha - a), normalizeAngle(phi + alpha - a));
+		}
+
+		// The arm is rigid, so C moves on a circle around A:
+		const Point C(ab + bc*cos(angle), bc*sin(angle));
+		const double rho = norm(C);
+		if (rho + Ey <= r || rho < EPSILON || Ey < EPSILON)
+			return RadianInterval(-M_PI, M_PI);
+		double cosAlpha = (rho*rho + Ey*Ey - r*r) / (2 * rho*Ey);
+		cosAlpha = MAX(-1.0, MIN(1.0, cosAlpha));
+		const double alpha = acos(cosAlpha);
+		const double beta = angleOfPoint(C);
+		return RadianInterval(normalizeAngle(M_PI / 2 - beta - alpha - rotation), normalizeAngle(M_PI / 2 - beta + alpha - rotation));
+	}
+
 	TwinJointRobotArmMotionAnalyzer::TwinJointRobotArmMotionAnalyzer(double ab, double bc) : ab(ab), bc(bc) {}
 
-	void TwinJointRobotArmMotionAnalyzer::analyzePointToCircle(double Ey, double radiusE, bool restrictBGivenA, AngleRestrictorFunctionList &restrictions) {
-		// TODO!
+	/*
+	Adds the primary intervals where minSin < sin(angle + shift) < maxSin.
+	*/
+	void TwinJointRobotArmMotionAnalyzer::addRestrictors(double minSin, double maxSin, double shift, const Function &f, AngleRestrictorFunctionList &restrictions) const {
+		if (minSin >= maxSin || minSin >= 1 || maxSin <= -1)
+			return;
+		const bool boundedBelow = minSin > -1;
+		const bool boundedAbove = maxSin < 1;
+
+		AngleRestrictorFunction restrictor;
+		restrictor.restrictionFunction = f;
+		if (!boundedBelow && !boundedAbove) {
+			restrictor.primaryInterval = Interval(-M_PI, M_PI);
+			restrictions.push_back(restrictor);
+			return;
+		}
+		if (boundedBelow && !boundedAbove) {
+			restrictor.primaryInterval = Interval(normalizeAngle(asin(minSin) - shift), normalizeAngle(M_PI - asin(minSin) - shift));
+			restrictions.push_back(restrictor);
+			return;
+		}
+		if (!boundedBelow && boundedAbove) {
+			restrictor.primaryInterval = Interval(normalizeAngle(M_PI - asin(maxSin) - shift), normalizeAngle(asin(maxSin) - shift));
+			restrictions.push_back(restrictor);
+			return;
+		}
+		restrictor.primaryInterval = Interval(normalizeAngle(asin(minSin) - shift), normalizeAngle(asin(maxSin) - shift));
+		restrictions.push_back(restrictor);
+		restrictor.primaryInterval = Interval(normalizeAngle(M_PI - asin(maxSin) - shift), normalizeAngle(M_PI - asin(minSin) - shift));
+		restrictions.push_back(restrictor);
+	}
+
+	void TwinJointRobotArmMotionAnalyzer::analyzePointToCircle(double Ey, double radiusE, bool restrictBGivenA, AngleRestrictorFunctionList &restrictions) const {
+		analyzePointToCircle(Point(0, Ey), radiusE, restrictBGivenA, restrictions);
+	}
+
+	/*
+	E is rotated onto the positive Y-axis, so that |EB| only depends on the sine of the angle of AB, and |AC| only on the cosine of the angle of BC.
+	*/
+	void TwinJointRobotArmMotionAnalyzer::analyzePointToCircle(const Point &E, double radiusE, bool restrictBGivenA, AngleRestrictorFunctionList &restrictions) const {
+		const double Ey = norm(E);
+		const double rotation = Ey < EPSILON ? 0 : M_PI / 2 - angleOfPoint(E);
+		const Function f(ab, bc, Ey, radiusE, rotation, restrictBGivenA);
+
+		if (restrictBGivenA) {
+			// |EB|^2 = ab^2 + Ey^2 - 2*ab*Ey*sin(angle of AB). Restricted when bc-r < |EB| < bc+r:
+			const double k = 2 * ab*Ey;
+			const double k0 = ab*ab + Ey*Ey;
+			if (k < EPSILON) {
+				const double d = sqrt(k0);
+				if (bc - radiusE < d && d < bc + radiusE)
+					addRestrictors(-2, 2, 0, f, restrictions);
+				return;
+			}
+			const double minSin = (k0 - (bc + radiusE)*(bc + radiusE)) / k;
+			const double maxSin = bc - radiusE > 0 ? (k0 - (bc - radiusE)*(bc - radiusE)) / k : 2;
+			addRestrictors(minSin, maxSin, rotation, f, restrictions);
+			return;
+		}
+
+		// |AC|^2 = ab^2 + bc^2 + 2*ab*bc*cos(angle of BC). Restricted when Ey-r < |AC| < Ey+r:
+		const double k = 2 * ab*bc;
+		const double k0 = ab*ab + bc*bc;
+		if (k < EPSILON) {
+			const double rho = sqrt(k0);
+			if (Ey - radiusE < rho && rho < Ey + radiusE)
+				addRestrictors(-2, 2, 0, f, restrictions);
+			return;
+		}
+		const double minCos = Ey - radiusE > 0 ? ((Ey - radiusE)*(Ey - radiusE) - k0) / k : -2;
+		const double maxCos = ((Ey + radiusE)*(Ey + radiusE) - k0) / k;
+		addRestrictors(minCos, maxCos, M_PI / 2, f, restrictions); // cos(a) = sin(a + PI/2)
+	}
+
+	void TwinJointRobotArmMotionAnalyzer::analyzePointToBox(const Point &center, double halfWidth, double halfHeight, bool restrictBGivenA, AngleRestrictorFunctionList &restrictions) const {
+		analyzePointToCircle(center, sqrt(halfWidth*halfWidth + halfHeight*halfHeight), restrictBGivenA, restrictions);
 	}
-}
\ No newline at end of file
+}
@@ -9,10 +9,26 @@ namespace geometry {
 	struct AngleRestrictorFunction; // Forward declaration.
 	typedef std::vector<AngleRestrictorFunction> AngleRestrictorFunctionList;
 
+	/*
+	Restriction of one joint angle as a function of the other joint angle:
+	The returned interval contains the angles for which C is strictly inside circle E.
+	Joint angles: The angle of AB is measured from the X-axis, while the angle of BC is measured from the direction of AB.
+	*/
 	struct Function {
-		// TODO: Analyze requirements!
+		double ab, bc, Ey, r; // Circle E at (0,Ey) in the rotated system. Ey >= 0.
+		double rotation; // Added to the angle of AB when going from the original system to the rotated system.
+		bool restrictBGivenA; // If true, the argument is the angle of AB. Otherwise it is the angle of BC.
+
+		Function();
+		Function(double ab, double bc, double Ey, double r, double rotation, bool restrictBGivenA);
+
+		RadianInterval operator()(double angle) const;
 	};
 
+	/*
+	For angles of the primary joint in primaryInterval, the other joint is restricted by restrictionFunction.
+	Outside primaryInterval the other joint is not restricted.
+	*/
 	struct AngleRestrictorFunction {
 		Interval primaryInterval;
 		Function restrictionFunction;
@@ -22,6 +38,8 @@ namespace geometry {
 	private:
 		double ab, bc; // Lengths |AB| and |BC|.
 
+		void addRestrictors(double minSin, double maxSin, double shift, const Function &f, AngleRestrictorFunctionList &restrictions) const;
+
 	public:
 		TwinJointRobotArmMotionAnalyzer(double ab, double bc);
 
@@ -29,8 +47,17 @@ namespace geometry {
 		Robot: Base A=(0,0), first joint -> B, second joint to C
 		Obstacle: Circle E at (0,Ey) and radius r.
 		*/
-		void analyzePointToCircle(double Ey, double r, bool restrictBGivenA, AngleRestrictorFunctionList &restrictions);
+		void analyzePointToCircle(double Ey, double r, bool restrictBGivenA, AngleRestrictorFunctionList &restrictions) const;
+		/*
+		As above with circle E at any point.
+		*/
+		void analyzePointToCircle(const Point &E, double r, bool restrictBGivenA, AngleRestrictorFunctionList &restrictions) const;
+		/*
+		Obstacle: Box with the given center and half side lengths in any orientation.
+		The box is covered by its circumscribed circle, so the restrictions are conservative.
+		*/
+		void analyzePointToBox(const Point &center, double halfWidth, double halfHeight, bool restrictBGivenA, AngleRestrictorFunctionList &restrictions) const;
 	};
 }
 
-#endif GEOMETRY_ROBOT_ARM_MOTION_PRIMITIVES_H
\ No newline at end of file
+#endif // GEOMETRY_ROBOT_ARM_MOTION_PRIMITIVES_H
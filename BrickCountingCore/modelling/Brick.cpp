@@ -27,7 +27,15 @@ namespace modelling {
 	/*
 	Main constructor: Built from a RectilinearModel by connecting to a brick at an angle.
 	*/
-	Brick::Brick(const RectilinearBrick& b, const ConnectionPoint& p, const geometry::Point &origin, double originAngle, int8_t originLv) : center(b.x - p.x(), b.y - p.y()), angle(originAngle), level(b.level() + originLv - p.brick.level()) {
+	Brick::Brick(const RectilinearBrick& b, const ConnectionPoint& p, const geometry::Point &origin, double originAngle, int8_t originLv) :
+		Brick(b, p, origin, originAngle, sin(turnAngle(p, originAngle)), cos(turnAngle(p, originAngle)), originLv) {
+	}
+
+	/*
+	As above, where sina and cosa are sine and cosine of turnAngle(p, originAngle).
+	Bricks of a block connected using the same connection point share the turn angle, so they can share sina and cosa.
+	*/
+	Brick::Brick(const RectilinearBrick& b, const ConnectionPoint& p, const geometry::Point &origin, double originAngle, double sina, double cosa, int8_t originLv) : center(b.x - p.x(), b.y - p.y()), angle(originAngle), level(b.level() + originLv - p.brick.level()) {
 #ifdef _BRICK
 		std::cout << "Building brick. RB=" << b << std::endl;
 		std::cout << " center compared to connection: " << center.X << "," << center.Y << std::endl << " point to connect to: " << origin.X << "," << origin.Y << ", angle of that point: " << originAngle << std::endl;
@@ -36,12 +44,9 @@ namespace modelling {
 
 		assert(level > -8);
 		assert(level < 8);
-		if (p.brick.horizontal())
-			angle += M_PI / 2;
+		angle = turnAngle(p, angle);
 		// center is now on b. Move by turn angle, then translate to origin:
 		// Rotate:
-		double sina = sin(angle);
-		double cosa = cos(angle);
 		double oldX = center.X;
 		center.X = center.X*cosa - center.Y*sina;
 		center.Y = oldX*sina + center.Y*cosa;
@@ -116,12 +121,14 @@ namespace modelling {
 	}
 
 	void Brick::movePointSoThisIsAxisAlignedAtOrigin(geometry::Point &b) const {
+		movePointSoThisIsAxisAlignedAtOrigin(sin(-angle), cos(-angle), b);
+	}
+
+	void Brick::movePointSoThisIsAxisAlignedAtOrigin(double sina, double cosa, geometry::Point &b) const {
 		// Tranlate to make this->origin = 0,0:
 		b.X -= center.X;
 		b.Y -= center.Y;
 		// translate according to angle to make this->angle = 0.
-		const double sina = sin(-angle);
-		const double cosa = cos(-angle);
 		const double oldX = b.X;
 		b.X = oldX*cosa - b.Y*sina;
 		b.Y = oldX*sina + b.Y*cosa;
@@ -20,6 +20,8 @@
 #define BRICK_UNIT_GAP 0.0000125
 #define STUD_RADIUS 0.3
 #define STUD_DIAM (STUD_RADIUS+STUD_RADIUS)
+// Half diagonal of the box of a brick at ADD_XY = MOLDING_TOLERANCE_MULTIPLIER, which has half sides 1 and 2:
+#define BRICK_HALF_DIAGONAL sqrt(5.0)
 // 0.0625 is 0.5 mm.
 #define SNAP_DISTANCE 0.0625
 // Molding tolerance: 0.1mm
@@ -48,6 +50,14 @@ namespace modelling {
 		Brick() : center(0, 0), angle(0), level(0) {}
 		Brick(double cx, double cy, double a, int8_t lv) : center(cx, cy), angle(a), level(lv) {}
 		Brick(const RectilinearBrick& b, const ConnectionPoint& p, const geometry::Point &origin, double originAngle, int8_t originLv);
+		Brick(const RectilinearBrick& b, const ConnectionPoint& p, const geometry::Point &origin, double originAngle, double sina, double cosa, int8_t originLv); // Using sine and cosine of the turn angle.
+
+		/*
+		Angle which the bricks of a block are turned by when connected using p at originAngle.
+		*/
+		static inline double turnAngle(const ConnectionPoint& p, double originAngle) {
+			return p.brick.horizontal() ? originAngle + M_PI / 2 : originAngle;
+		}
 
 		void /*Brick::*/toLDR(std::ofstream &os, int ldrColor) const;
 
@@ -55,12 +65,18 @@ namespace modelling {
 
 		void /*Brick::*/moveBrickSoThisIsAxisAlignedAtOrigin(Brick &b) const;
 		void /*Brick::*/movePointSoThisIsAxisAlignedAtOrigin(geometry::Point &p) const;
+		void /*Brick::*/movePointSoThisIsAxisAlignedAtOrigin(double sinNegAngle, double cosNegAngle, geometry::Point &p) const; // Using sin(-angle) and cos(-angle).
 
 		template <int ADD_XY>
 		void /*Brick::*/getBoxPOIs(geometry::Point *pois) const {
-			double sina = sin(angle);
-			double cosa = cos(angle);
+			getBoxPOIs<ADD_XY>(sin(angle), cos(angle), pois);
+		}
 
+		/*
+		As above using precomputed sine and cosine of the angle.
+		*/
+		template <int ADD_XY>
+		void /*Brick::*/getBoxPOIs(double sina, double cosa, geometry::Point *pois) const {
 			const double dx = VERTICAL_BRICK_CENTER_TO_SIDE + ADD_XY * BRICK_UNIT_GAP;
 			const double dy = VERTICAL_BRICK_CENTER_TO_TOP + ADD_XY * BRICK_UNIT_GAP;
 
@@ -328,20 +344,24 @@ namespace modelling {
 
 		template <int ADD_XY>
 		bool /*Brick::*/boxIntersectsPOIsFrom(Brick &b) const {
-			const double dx = VERTICAL_BRICK_CENTER_TO_SIDE + ADD_XY * BRICK_UNIT_GAP;
-			const double dy = VERTICAL_BRICK_CENTER_TO_TOP + ADD_XY * BRICK_UNIT_GAP;
 			moveBrickSoThisIsAxisAlignedAtOrigin(b);
 			// Get POIs:
 			geometry::Point pois[NUMBER_OF_POIS_FOR_BOX_INTERSECTION];
 			b.getBoxPOIs<ADD_XY>(pois);
-			// Check each POI:
+			return boxContainsAnyPOI<ADD_XY>(pois);
+		}
+
+		/*
+		POIs are of a brick moved so that the box is axis aligned at the origin.
+		*/
+		template <int ADD_XY>
+		static bool /*Brick::*/boxContainsAnyPOI(const geometry::Point *pois) {
+			const double dx = VERTICAL_BRICK_CENTER_TO_SIDE + ADD_XY * BRICK_UNIT_GAP;
+			const double dy = VERTICAL_BRICK_CENTER_TO_TOP + ADD_XY * BRICK_UNIT_GAP;
 			for (int i = 0; i < NUMBER_OF_POIS_FOR_BOX_INTERSECTION; ++i) {
-				geometry::Point &poi = pois[i];
-				if (poi.X < 0)
-					poi.X = -poi.X;
-				if (poi.Y < 0)
-					poi.Y = -poi.Y;
-				if (poi.X + EPSILON < dx && poi.Y + EPSILON < dy) {
+				const double x = pois[i].X < 0 ? -pois[i].X : pois[i].X;
+				const double y = pois[i].Y < 0 ? -pois[i].Y : pois[i].Y;
+				if (x + EPSILON < dx && y + EPSILON < dy) {
 					return true;
 				}
 			}
@@ -353,11 +373,69 @@ namespace modelling {
 		*/
 		template <int ADD_XY>
 		bool /*Brick::*/boxesIntersect(const Brick &b) const {
+#ifdef _SAT_BOX_INTERSECTION
+			return boxesIntersectSAT<ADD_XY>(b);
+#else
+			return boxesIntersectPOI<ADD_XY>(b);
+#endif
+		}
+
+		/*
+		Boxes intersect if a POI of one box is inside the other. See getBoxPOIs().
+		*/
+		template <int ADD_XY>
+		bool /*Brick::*/boxesIntersectPOI(const Brick &b) const {
 			Brick tmpB(b);
 			Brick tmpThis(*this);
 			return boxIntersectsPOIsFrom<ADD_XY>(tmpB) || b.boxIntersectsPOIsFrom<ADD_XY>(tmpThis);
 		}
 
+		/*
+		Separating axis test: The boxes intersect unless they are separated along one of the four side normals (see http://www.ragestorm.net/tutorial?id=22).
+		As for the POIs, the boxes must overlap by more than EPSILON along all four normals in order to intersect.
+		Early outs: Boxes are separated if the circumscribed circles or the axis aligned bounding boxes are.
+		*/
+		template <int ADD_XY>
+		bool /*Brick::*/boxesIntersectSAT(const Brick &b) const {
+			const double dx = VERTICAL_BRICK_CENTER_TO_SIDE + ADD_XY * BRICK_UNIT_GAP;
+			const double dy = VERTICAL_BRICK_CENTER_TO_TOP + ADD_XY * BRICK_UNIT_GAP;
+			const double vx = b.center.X - center.X;
+			const double vy = b.center.Y - center.Y;
+			// Circumscribed circles:
+			if (vx*vx + vy*vy >= 4 * (dx*dx + dy*dy))
+				return false;
+			// Axis aligned bounding boxes:
+			const double sina = sin(angle), cosa = cos(angle);
+			const double sinb = sin(b.angle), cosb = cos(b.angle);
+			const double absSina = fabs(sina), absCosa = fabs(cosa), absSinb = fabs(sinb), absCosb = fabs(cosb);
+			if (fabs(vx) >= dx*(absCosa + absCosb) + dy*(absSina + absSinb) || fabs(vy) >= dx*(absSina + absSinb) + dy*(absCosa + absCosb))
+				return false;
+			// Move b into the system of this:
+			const geometry::Point centerOfB(vx*cosa + vy*sina, vy*cosa - vx*sina);
+			return boxIntersectsBoxSAT<ADD_XY>(centerOfB, sinb*cosa - cosb*sina, cosb*cosa + sinb*sina);
+		}
+
+		/*
+		Separating axis test against the box of a brick moved so that this is axis aligned at the origin.
+		sinb and cosb are sine and cosine of the angle of the moved brick.
+		*/
+		template <int ADD_XY>
+		static bool /*Brick::*/boxIntersectsBoxSAT(const geometry::Point &centerOfB, double sinb, double cosb) {
+			const double dx = VERTICAL_BRICK_CENTER_TO_SIDE + ADD_XY * BRICK_UNIT_GAP;
+			const double dy = VERTICAL_BRICK_CENTER_TO_TOP + ADD_XY * BRICK_UNIT_GAP;
+			// Half sides of one box projected onto the normals of the other:
+			const double c = fabs(cosb), s = fabs(sinb);
+			const double projectedX = dx*c + dy*s; // Onto the normal of the other box corresponding to its X-axis.
+			const double projectedY = dx*s + dy*c;
+			// Normals of this box:
+			if (fabs(centerOfB.X) + EPSILON >= dx + projectedX || fabs(centerOfB.Y) + EPSILON >= dy + projectedY)
+				return false;
+			// Normals of b:
+			if (fabs(centerOfB.X*cosb + centerOfB.Y*sinb) + EPSILON >= dx + projectedX || fabs(centerOfB.Y*cosb - centerOfB.X*sinb) + EPSILON >= dy + projectedY)
+				return false;
+			return true;
+		}
+
 		template <int ADD_XY>
 		bool /*Brick::*/boxIntersectsOuterStud(const geometry::Point &studOfB, bool &connected, ConnectionPoint &foundConnectionThis, ConnectionPoint &foundConnectionB, const RectilinearBrick &source, const RectilinearBrick &bSource, int i) const {
 			const double cornerX = VERTICAL_BRICK_CENTER_TO_SIDE + ADD_XY * BRICK_UNIT_GAP;
@@ -406,10 +484,17 @@ namespace modelling {
 			moveBrickSoThisIsAxisAlignedAtOrigin(b);
 			geometry::Point studsOfB[NUMBER_OF_STUDS];
 			b.getStudPositions(studsOfB);
+			return boxIntersectsStuds<ADD_XY>(studsOfB, bSource, connected, foundConnectionB, foundConnectionThis, source);
+		}
 
+		/*
+		Studs are of a brick moved so that this is axis aligned at the origin.
+		*/
+		template <int ADD_XY>
+		bool /*Brick::*/boxIntersectsStuds(const geometry::Point *studsOfB, const RectilinearBrick &bSource, bool &connected, ConnectionPoint &foundConnectionB, ConnectionPoint &foundConnectionThis, const RectilinearBrick &source) const {
 			// X handle four inner:
 			for (int i = 0; i < 4; ++i) {
-				geometry::Point &stud = studsOfB[i];
+				geometry::Point stud = studsOfB[i];
 				if (boxIntersectsInnerStud<ADD_XY>(stud)) {
 					connected = false;
 					return true;
@@ -428,8 +513,7 @@ namespace modelling {
 		Return true if this brick intersects the other.
 		If the two bricks are corner connected, then connected is set to true and the found connection is set.
 		1: If not even close level-wise: return false.
-		2: If on same level: Check that boxes do not collide.
-		- If current implementation doesn't work, use algorithm from http://www.ragestorm.net/tutorial?id=22
+		2: If on same level: Check that boxes do not collide using POIs, or the separating axis test if _SAT_BOX_INTERSECTION is defined.
 		3: If on adjacent levels:
 		- If any of the 8 studs of lower brick inside box of upper: intersect.
 		- If intersect: Check if only intersecting one corner stud.
@@ -453,6 +537,7 @@ namespace modelling {
 
 		bool operator < (const Brick &b) const;
 	};
+
 }
 
 #endif // MODELLING_BRICK_H
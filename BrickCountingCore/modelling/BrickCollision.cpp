@@ -0,0 +1,114 @@
+#include "BrickCollision.h"
+
+#include <math.h>
+#include <assert.h>
+
+namespace modelling {
+	BrickSoA::BrickSoA() : size(0) {
+		for (unsigned int i = 0; i < MAX_SOA_BRICKS; ++i) {
+			x[i] = y[i] = angle[i] = 0;
+			sinNegAngle[i] = 0;
+			cosNegAngle[i] = 1;
+			level[i] = 1000; // Never within reach.
+		}
+	}
+
+	void BrickSoA::push_back(const Brick &b) {
+		assert(size < MAX_SOA_BRICKS);
+		x[size] = b.center.X;
+		y[size] = b.center.Y;
+		level[size] = b.level;
+		angle[size] = b.angle;
+		sinNegAngle[size] = sin(-b.angle);
+		cosNegAngle[size] = cos(-b.angle);
+		++size;
+	}
+
+	Brick BrickSoA::get(unsigned int i) const {
+		assert(i < size);
+		return Brick(x[i], y[i], angle[i], (int8_t)level[i]);
+	}
+
+	unsigned int BrickSoA::candidatesFor(const Brick &b) const {
+		const double reach = 2 * (BRICK_HALF_DIAGONAL + EPSILON);
+		unsigned int ret = 0;
+#if defined(BRICK_COLLISION_AVX)
+		const __m256d signMask = _mm256_set1_pd(-0.0);
+		const __m256d bx = _mm256_set1_pd(b.center.X), by = _mm256_set1_pd(b.center.Y), bLevel = _mm256_set1_pd(b.level);
+		const __m256d reach2 = _mm256_set1_pd(reach * reach), maxLevelDiff = _mm256_set1_pd(1.5);
+		for (unsigned int i = 0; i < size; i += 4) {
+			const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), bx);
+			const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), by);
+			const __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+			const __m256d levelDiff = _mm256_andnot_pd(signMask, _mm256_sub_pd(_mm256_loadu_pd(level + i), bLevel));
+			const __m256d candidate = _mm256_and_pd(_mm256_cmp_pd(d2, reach2, _CMP_LT_OQ), _mm256_cmp_pd(levelDiff, maxLevelDiff, _CMP_LT_OQ));
+			ret |= (unsigned int)_mm256_movemask_pd(candidate) << i;
+		}
+#elif defined(BRICK_COLLISION_SSE2)
+		const __m128d signMask = _mm_set1_pd(-0.0);
+		const __m128d bx = _mm_set1_pd(b.center.X), by = _mm_set1_pd(b.center.Y), bLevel = _mm_set1_pd(b.level);
+		const __m128d reach2 = _mm_set1_pd(reach * reach), maxLevelDiff = _mm_set1_pd(1.5);
+		for (unsigned int i = 0; i < size; i += 2) {
+			const __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), bx);
+			const __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), by);
+			const __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+			const __m128d levelDiff = _mm_andnot_pd(signMask, _mm_sub_pd(_mm_loadu_pd(level + i), bLevel));
+			const __m128d candidate = _mm_and_pd(_mm_cmplt_pd(d2, reach2), _mm_cmplt_pd(levelDiff, maxLevelDiff));
+			ret |= (unsigned int)_mm_movemask_pd(candidate) << i;
+		}
+#else
+		for (unsigned int i = 0; i < size; ++i) {
+			const double dx = x[i] - b.center.X;
+			const double dy = y[i] - b.center.Y;
+			const double levelDiff = fabs(level[i] - b.level);
+			if (dx*dx + dy*dy < reach * reach && levelDiff < 1.5)
+				ret |= 1u << i;
+		}
+#endif
+		// Entries from size and on are never candidates, as their level is out of reach.
+		return ret;
+	}
+
+	BrickPairGeometry::BrickPairGeometry(const Brick &a, const Brick &b) : levelDiff(b.level - a.level) {
+		if (levelDiff > 1 || levelDiff < -1) {
+			clearance = 1;
+			return;
+		}
+		clearance = geometry::norm(geometry::Point(b.center.X - a.center.X, b.center.Y - a.center.Y)) - 2 * (BRICK_HALF_DIAGONAL + EPSILON);
+		if (isClear())
+			return;
+		init(a, sin(-a.angle), cos(-a.angle), b, sin(-b.angle), cos(-b.angle));
+	}
+
+	BrickPairGeometry::BrickPairGeometry(const BrickSoA &a, unsigned int i, const Brick &b, double sinNegB, double cosNegB) : clearance(-1) {
+		const Brick ai = a.get(i);
+		levelDiff = b.level - ai.level;
+		assert(levelDiff <= 1 && levelDiff >= -1);
+		init(ai, a.sinNegAngle[i], a.cosNegAngle[i], b, sinNegB, cosNegB);
+	}
+
+	/*
+	Same as moving the bricks using Brick::moveBrickSoThisIsAxisAlignedAtOrigin(), but with sine and cosine of -angle of a and b given.
+	*/
+	void BrickPairGeometry::init(const Brick &a, double sinNegA, double cosNegA, const Brick &b, double sinNegB, double cosNegB) {
+		if (levelDiff == 0) {
+			bInA = b;
+			a.movePointSoThisIsAxisAlignedAtOrigin(sinNegA, cosNegA, bInA.center);
+			bInA.angle -= a.angle;
+			sinBInA = sin(bInA.angle);
+			cosBInA = cos(bInA.angle);
+			aInB = a;
+			b.movePointSoThisIsAxisAlignedAtOrigin(sinNegB, cosNegB, aInB.center);
+			aInB.angle -= b.angle;
+			sinAInB = sin(aInB.angle);
+			cosAInB = cos(aInB.angle);
+			return;
+		}
+		const bool bIsUpper = levelDiff > 0;
+		upper = bIsUpper ? b : a;
+		Brick lower(bIsUpper ? a : b);
+		upper.movePointSoThisIsAxisAlignedAtOrigin(bIsUpper ? sinNegB : sinNegA, bIsUpper ? cosNegB : cosNegA, lower.center);
+		lower.angle -= upper.angle;
+		lower.getStudPositions(studs);
+	}
+}
@@ -0,0 +1,152 @@
+#ifndef MODELLING_BRICK_COLLISION_H
+#define MODELLING_BRICK_COLLISION_H
+
+#include <stdint.h>
+
+#include "Brick.h"
+
+/*
+SIMD instructions used by the collision kernels: AVX (4 doubles) if enabled for the compiler (/arch:AVX or -mavx), otherwise SSE2 (2 doubles), which all x64 processors have.
+Define BRICK_COLLISION_SCALAR to use the scalar fallback.
+Only separate multiplications and additions are used, so the kernels compute exactly the same values as the scalar code in Brick.
+*/
+#if !defined(BRICK_COLLISION_SCALAR) && defined(__AVX__)
+#define BRICK_COLLISION_AVX
+#include <immintrin.h>
+#elif !defined(BRICK_COLLISION_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define BRICK_COLLISION_SSE2
+#include <emmintrin.h>
+#endif
+
+// Capacity of BrickSoA. A multiple of 4 so that the arrays can be processed 4 at a time:
+#define MAX_SOA_BRICKS 8
+// The 10 POIs of a box padded to a multiple of 4:
+#define NUMBER_OF_PADDED_POIS 12
+
+namespace modelling {
+	/*
+	Same as getBoxPOIs<ADD_XY>(sina, cosa, pois) of b followed by Brick::boxContainsAnyPOI<ADD_XY>(pois), where all POIs are computed and checked using SIMD instructions.
+	The POIs are center + (kx*cosa - ky*sina, kx*sina + ky*cosa) for the offsets (kx,ky) of the POIs in the system of b.
+	*/
+	template <int ADD_XY>
+	bool boxContainsAnyPOIOf(const Brick &b, double sina, double cosa) {
+		const double dx = VERTICAL_BRICK_CENTER_TO_SIDE + ADD_XY * BRICK_UNIT_GAP;
+		const double dy = VERTICAL_BRICK_CENTER_TO_TOP + ADD_XY * BRICK_UNIT_GAP;
+#if defined(BRICK_COLLISION_AVX) || defined(BRICK_COLLISION_SSE2)
+		// 4 corners, 2 inner, 4 sides and 2 copies of the first corner as padding:
+		const double kx[NUMBER_OF_PADDED_POIS] = { -dx, dx, dx, -dx, 0, 0, dx, -dx, 0, 0, -dx, -dx };
+		const double ky[NUMBER_OF_PADDED_POIS] = { dy, dy, -dy, -dy, -0.75, 0.75, 0, 0, -dy, dy, dy, dy };
+#ifdef BRICK_COLLISION_AVX
+		const __m256d signMask = _mm256_set1_pd(-0.0);
+		const __m256d cx = _mm256_set1_pd(b.center.X), cy = _mm256_set1_pd(b.center.Y);
+		const __m256d s = _mm256_set1_pd(sina), c = _mm256_set1_pd(cosa);
+		const __m256d eps = _mm256_set1_pd(EPSILON), limitX = _mm256_set1_pd(dx), limitY = _mm256_set1_pd(dy);
+		for (int i = 0; i < NUMBER_OF_PADDED_POIS; i += 4) {
+			const __m256d x = _mm256_loadu_pd(kx + i), y = _mm256_loadu_pd(ky + i);
+			__m256d px = _mm256_add_pd(cx, _mm256_sub_pd(_mm256_mul_pd(x, c), _mm256_mul_pd(y, s)));
+			__m256d py = _mm256_add_pd(cy, _mm256_add_pd(_mm256_mul_pd(x, s), _mm256_mul_pd(y, c)));
+			px = _mm256_andnot_pd(signMask, px);
+			py = _mm256_andnot_pd(signMask, py);
+			const __m256d inside = _mm256_and_pd(_mm256_cmp_pd(_mm256_add_pd(px, eps), limitX, _CMP_LT_OQ), _mm256_cmp_pd(_mm256_add_pd(py, eps), limitY, _CMP_LT_OQ));
+			if (_mm256_movemask_pd(inside) != 0)
+				return true;
+		}
+#else
+		const __m128d signMask = _mm_set1_pd(-0.0);
+		const __m128d cx = _mm_set1_pd(b.center.X), cy = _mm_set1_pd(b.center.Y);
+		const __m128d s = _mm_set1_pd(sina), c = _mm_set1_pd(cosa);
+		const __m128d eps = _mm_set1_pd(EPSILON), limitX = _mm_set1_pd(dx), limitY = _mm_set1_pd(dy);
+		for (int i = 0; i < NUMBER_OF_PADDED_POIS; i += 2) {
+			const __m128d x = _mm_loadu_pd(kx + i), y = _mm_loadu_pd(ky + i);
+			__m128d px = _mm_add_pd(cx, _mm_sub_pd(_mm_mul_pd(x, c), _mm_mul_pd(y, s)));
+			__m128d py = _mm_add_pd(cy, _mm_add_pd(_mm_mul_pd(x, s), _mm_mul_pd(y, c)));
+			px = _mm_andnot_pd(signMask, px);
+			py = _mm_andnot_pd(signMask, py);
+			const __m128d inside = _mm_and_pd(_mm_cmplt_pd(_mm_add_pd(px, eps), limitX), _mm_cmplt_pd(_mm_add_pd(py, eps), limitY));
+			if (_mm_movemask_pd(inside) != 0)
+				return true;
+		}
+#endif
+		return false;
+#else
+		geometry::Point pois[NUMBER_OF_POIS_FOR_BOX_INTERSECTION];
+		b.getBoxPOIs<ADD_XY>(sina, cosa, pois);
+		return Brick::boxContainsAnyPOI<ADD_XY>(pois);
+#endif
+	}
+
+	/*
+	Bricks in a structure of arrays, so that a brick can be tested against all of them using SIMD instructions.
+	Used for the bricks of a model which a turning block might collide with: These are tested against many positions of the block,
+	so sine and cosine of -angle, which move other bricks into the system of a brick, are cached.
+	Unused entries have a level which is never within reach.
+	*/
+	struct BrickSoA {
+		double x[MAX_SOA_BRICKS], y[MAX_SOA_BRICKS], level[MAX_SOA_BRICKS];
+		double angle[MAX_SOA_BRICKS], sinNegAngle[MAX_SOA_BRICKS], cosNegAngle[MAX_SOA_BRICKS];
+		unsigned int size;
+
+		BrickSoA();
+
+		void push_back(const Brick &b);
+		Brick get(unsigned int i) const;
+
+		/*
+		Returns a bit mask of the bricks which b might intersect: Those at most one level from b with centers closer than 2*BRICK_HALF_DIAGONAL plus EPSILON for rounding.
+		*/
+		unsigned int candidatesFor(const Brick &b) const;
+	};
+
+	/*
+	Geometry of two bricks which is shared when checking their intersection at multiple tolerances, such as for S, M and L:
+	The clearance is the distance between the centers minus the bounding radii of the boxes at the largest tolerance.
+	Bricks with positive clearance (or more than one level apart) do not intersect at any tolerance with |ADD_XY| <= MOLDING_TOLERANCE_MULTIPLIER.
+	Otherwise the bricks are moved into the systems of each other once, and intersects<ADD_XY>() only compares against the box sizes.
+	intersects<ADD_XY>() returns the same as Brick::intersects<ADD_XY>().
+	*/
+	class BrickPairGeometry {
+	private:
+		int8_t levelDiff; // Level of b minus level of a.
+		double clearance;
+		// Same level: Each brick in the system of the other, with sine and cosine of its angle in that system:
+		Brick bInA, aInB;
+		double sinBInA, cosBInA, sinAInB, cosAInB;
+		// Adjacent levels: The studs of the lower brick in the system of the upper brick:
+		Brick upper;
+		geometry::Point studs[NUMBER_OF_STUDS];
+
+		void init(const Brick &a, double sinNegA, double cosNegA, const Brick &b, double sinNegB, double cosNegB);
+
+	public:
+		BrickPairGeometry(const Brick &a, const Brick &b);
+		/*
+		For brick i of a, which must be a candidate for b (see BrickSoA::candidatesFor()). sinNegB and cosNegB are sin(-b.angle) and cos(-b.angle).
+		*/
+		BrickPairGeometry(const BrickSoA &a, unsigned int i, const Brick &b, double sinNegB, double cosNegB);
+
+		inline bool isClear() const {
+			return clearance > 0;
+		}
+
+		template <int ADD_XY>
+		bool intersects(bool &connected) const {
+			assert(ADD_XY <= MOLDING_TOLERANCE_MULTIPLIER && -ADD_XY <= MOLDING_TOLERANCE_MULTIPLIER);
+			connected = false;
+			if (isClear())
+				return false;
+			if (levelDiff == 0) {
+#ifdef _SAT_BOX_INTERSECTION
+				return Brick::boxIntersectsBoxSAT<ADD_XY>(bInA.center, sinBInA, cosBInA);
+#else
+				return boxContainsAnyPOIOf<ADD_XY>(bInA, sinBInA, cosBInA) || boxContainsAnyPOIOf<ADD_XY>(aInB, sinAInB, cosAInB);
+#endif
+			}
+			// Only connected is used from the found connection points:
+			ConnectionPoint foundConnectionUpper, foundConnectionLower;
+			RectilinearBrick source;
+			return upper.boxIntersectsStuds<ADD_XY>(studs, source, connected, foundConnectionLower, foundConnectionUpper, source);
+		}
+	};
+}
+
+#endif // MODELLING_BRICK_COLLISION_H
@@ -14,11 +14,14 @@
 
 #include "../util/LDRPrintable.h"
 #include "Brick.h"
+#include "BrickCollision.h"
 #include "RectilinearBrick.h"
 #include "ConnectionPoint.h"
 #include "Block.hpp"
 
 #define MAX_ANGLE_RADIANS 0.664054277
+// Connections in a connection list: At most 5 in each half of an Encoding.
+#define MAX_CONNECTION_PAIRS 10
 
 namespace modelling {
 	typedef std::pair<IConnectionPoint, IConnectionPoint> IConnectionPair;
@@ -111,9 +114,12 @@ namespace modelling {
 		return os;
 	}
 
+	/*
+	Connection lists are small, so the set is kept as a sorted array rather than a tree.
+	*/
 	struct IConnectionPairSet {
 	private:
-		std::set<IConnectionPair> v;
+		util::TinyVector<IConnectionPair, MAX_CONNECTION_PAIRS> v;
 	public:
 		IConnectionPairSet() {}
 		IConnectionPairSet(const IConnectionPairSet &l) : v(l.v) {}
@@ -127,7 +133,7 @@ namespace modelling {
 		bool operator<(const IConnectionPairSet &l) const {
 			if (v.size() != l.v.size())
 				return v.size() < l.v.size();
-			for (std::set<IConnectionPair>::const_iterator it1 = v.begin(), it2 = l.v.begin(); it1 != v.end(); ++it1, ++it2) {
+			for (const IConnectionPair *it1 = v.begin(), *it2 = l.v.begin(); it1 != v.end(); ++it1, ++it2) {
 				const IConnectionPair &c1 = *it1;
 				const IConnectionPair &c2 = *it2;
 				if (c1 != c2)
@@ -139,16 +145,25 @@ namespace modelling {
 			if (toInsert.first.first.modelBlockI > toInsert.second.first.modelBlockI) {
 				std::swap(toInsert.first, toInsert.second);
 			}
-			v.insert(toInsert);
+			// Insertion sort. Duplicates are ignored:
+			unsigned int i = v.size();
+			while (i > 0 && toInsert < v[i - 1])
+				--i;
+			if (i > 0 && v[i - 1] == toInsert)
+				return;
+			v.push_back(toInsert);
+			for (unsigned int j = v.size() - 1; j > i; --j)
+				v[j] = v[j - 1];
+			v[i] = toInsert;
 		}
 		void insert(const AngledConnection &c) {
 			IConnectionPair toInsert(c.p1, c.p2);
 			insert(toInsert);
 		}
-		std::set<IConnectionPair>::const_iterator begin() const {
+		const IConnectionPair* begin() const {
 			return v.begin();
 		}
-		std::set<IConnectionPair>::const_iterator end() const {
+		const IConnectionPair* end() const {
 			return v.end();
 		}
 		size_t size() const {
@@ -156,7 +171,7 @@ namespace modelling {
 		}
 	};
 	inline std::ostream& operator<<(std::ostream &os, const IConnectionPairSet& l) {
-		for (std::set<IConnectionPair>::const_iterator it = l.begin(); it != l.end(); ++it) {
+		for (const IConnectionPair* it = l.begin(); it != l.end(); ++it) {
 			os << it->first << "/" << it->second << " ";
 		}
 		return os;
@@ -171,6 +186,17 @@ namespace modelling {
 		IBrick(const IBrick &ib) : rb(ib.rb), b(ib.b), bi(ib.bi) {}
 	};
 
+	/*
+	Where a block is connected to a model. This is the same for all angles of the connection, so it is computed once by Model::getBlockPlacement() and then used by Model::push() for each angle.
+	*/
+	struct BlockPlacement {
+		int modelBlockI;
+		ConnectionPoint point; // Connection point of the block.
+		geometry::Point stud; // Position of the connection point of the model.
+		double angle; // Angle of the block when the connection angle is 0.
+		int8_t level;
+	};
+
 	struct Model : public util::LDRPrintable {
 		//private:
 		Brick origBricks[6];
@@ -230,6 +256,45 @@ namespace modelling {
 			return true;
 		}
 
+		/*
+		Evaluates isRealizable<-ADD_XY>, isRealizable<0> and isRealizable<ADD_XY> (S, M and L) in one pass over the possible collisions.
+		collisions holds the bricks of the possible collisions (see getCollisionBricks()), which are the same for all positions of the last block.
+		Each of the last bricks is tested against all of them at once by BrickSoA::candidatesFor(), and the geometry of each candidate pair is computed once by BrickPairGeometry.
+		s, m and l should be true for the checks to perform. They are set to false when the model is not realizable with that tolerance.
+		*/
+		template <int ADD_XY>
+		void isRealizableSML(const BrickSoA &collisions, int end, bool &s, bool &m, bool &l) const {
+			for (int j = 0; j < end; ++j) {
+				const Brick &b = bricks[j + bricksSize - end].b;
+				unsigned int candidates = collisions.candidatesFor(b);
+				if (candidates == 0)
+					continue;
+				const double sinNegB = sin(-b.angle), cosNegB = cos(-b.angle);
+				for (unsigned int i = 0; candidates != 0; ++i, candidates >>= 1) {
+					if ((candidates & 1) == 0)
+						continue;
+					if (!s && !m && !l)
+						return;
+					const BrickPairGeometry g(collisions, i, b, sinNegB, cosNegB);
+					bool connected;
+					if (s && g.intersects<-ADD_XY>(connected) && !connected)
+						s = false;
+					if (m && g.intersects<0>(connected) && !connected)
+						m = false;
+					if (l && g.intersects<ADD_XY>(connected) && !connected)
+						l = false;
+				}
+			}
+		}
+
+		void getCollisionBricks(const util::TinyVector<int, 5> &possibleCollisions, BrickSoA &result) const {
+			for (const int* it = possibleCollisions.begin(); it != possibleCollisions.end(); ++it)
+				result.push_back(bricks[*it].b);
+		}
+
+		/*
+		Bricks of this model on the same or an adjacent level as a brick of block when connected using connectionPair.
+		*/
 		void getPossibleCollisions(const FatBlock &block, const IConnectionPair &connectionPair, util::TinyVector<int, 5> &result) const {
 			int prevBrickI = connectionPair.P1.first.modelBlockI;
 			const Brick &prevOrigBrick = origBricks[prevBrickI];
@@ -255,6 +320,44 @@ namespace modelling {
 			}
 		}
 
+		/*
+		As getPossibleCollisions() with a broad phase for when only the angle of the connection changes (the stud is fixed in this model):
+		Turning around the stud, each brick of the block sweeps an annulus around the stud. The bounding circle of a brick in this model
+		has to overlap the annulus of a brick of the block on the same or an adjacent level for them to possibly collide.
+		The annuli cover all angles, so the result holds for any angle of the connection.
+		*/
+		void getSweptPossibleCollisions(const FatBlock &block, const IConnectionPair &connectionPair, util::TinyVector<int, 5> &result) const {
+			BlockPlacement placement;
+			getBlockPlacement(connectionPair.P2.first.modelBlockI, connectionPair, placement);
+
+			// Level and distance to the stud of each brick of the block:
+			int8_t blockLevels[6];
+			double blockRadii[6];
+			RectilinearBrick rb;
+			for (int j = 0; j < block.size; rb = block.otherBricks[j++]) {
+				const Brick brick(rb, placement.point, placement.stud, placement.angle, placement.level);
+				blockLevels[j] = brick.level;
+				blockRadii[j] = geometry::dist(placement.stud, brick.center);
+			}
+
+			for (int i = 0; i < bricksSize; ++i) {
+				const IBrick &ib = bricks[i];
+				if (block.size == 1 && connectionPair.P1.first.modelBlockI == ib.bi.modelBlockI && connectionPair.P1.first.brickIndexInBlock == ib.bi.brickIndexInBlock)
+					continue; // Exclude brick we are connecting to.
+				const int8_t levelI = ib.b.level;
+				const double radiusI = geometry::dist(placement.stud, ib.b.center);
+				for (int j = 0; j < block.size; ++j) {
+					const int8_t levelJ = blockLevels[j];
+					if (levelI != levelJ && levelI + 1 != levelJ && levelJ + 1 != levelI)
+						continue;
+					if (fabs(radiusI - blockRadii[j]) < 2 * (BRICK_HALF_DIAGONAL + EPSILON)) {
+						result.push_back(i);
+						break;
+					}
+				}
+			}
+		}
+
 		void initBlock(const FatBlock &block) {
 			assert(bricksSize == 0);
 #ifdef _TRACE
@@ -273,31 +376,56 @@ namespace modelling {
 			initBlock(block);
 		}
 
-		void add(const FatBlock &block, int modelBlockI, AngledConnection c) {
+		void add(const FatBlock &block, int modelBlockI, const AngledConnection &c) {
+			BlockPlacement placement;
+			getBlockPlacement(modelBlockI, IConnectionPair(c.p1, c.p2), placement);
+			push(block, placement, c.angleToRadians());
+		}
+
+		void getBlockPlacement(int modelBlockI, IConnectionPair c, BlockPlacement &placement) const {
 			// Get objects of interest:
-			if (modelBlockI == c.p1.first.modelBlockI) {
-				std::swap(c.p1, c.p2);
+			if (modelBlockI == c.P1.first.modelBlockI) {
+				std::swap(c.P1, c.P2);
 			}
-			int prevBrickI = c.p1.first.modelBlockI;
-			int currBrickI = c.p2.first.modelBlockI;
-			Brick &prevOrigBrick = origBricks[prevBrickI];
-			const ConnectionPoint &prevPoint = c.p1.second;
-			const ConnectionPoint &currPoint = c.p2.second;
-			Brick prevBrick(prevOrigBrick, c.p1.second.brick);
-			geometry::Point prevStud = prevBrick.getStudPosition(prevPoint.type);
-
-			// Compute position of bricks:
-			double angle = prevBrick.angle + M_PI / 2 * (currPoint.type - prevPoint.type - 2) + c.angleToRadians();
-			int8_t level = prevOrigBrick.level + prevPoint.brick.level() + (prevPoint.above ? 1 : -1);
+			int prevBrickI = c.P1.first.modelBlockI;
+			const Brick &prevOrigBrick = origBricks[prevBrickI];
+			const ConnectionPoint &prevPoint = c.P1.second;
+			const ConnectionPoint &currPoint = c.P2.second;
+			Brick prevBrick(prevOrigBrick, prevPoint.brick);
+
+			placement.modelBlockI = c.P2.first.modelBlockI;
+			placement.point = currPoint;
+			placement.stud = prevBrick.getStudPosition(prevPoint.type);
+			placement.angle = prevBrick.angle + M_PI / 2 * (currPoint.type - prevPoint.type - 2);
+			placement.level = prevOrigBrick.level + prevPoint.brick.level() + (prevPoint.above ? 1 : -1);
+		}
+
+		/*
+		Adds the bricks of block placed at the given connection angle. Only the bricks of the block are computed, and they share the sine and cosine of the turn angle.
+		Remove the block again using pop() in order to place it at another angle.
+		*/
+		void push(const FatBlock &block, const BlockPlacement &placement, double angle) {
+			assert(bricksSize + block.size <= 6);
+			angle = placement.angle + angle;
+			const double turnAngle = Brick::turnAngle(placement.point, angle);
+			const double sina = sin(turnAngle), cosa = cos(turnAngle);
 
 			RectilinearBrick rb;
-			origBricks[currBrickI] = Brick(rb, currPoint, prevStud, angle, level);
 			for (int i = 0; i < block.size; rb = block.otherBricks[i++]) {
-				Brick brick(rb, currPoint, prevStud, angle, level);
+				Brick brick(rb, placement.point, placement.stud, angle, sina, cosa, placement.level);
 
-				IBrick ib(rb, brick, BrickIdentifier(block.index, i, currBrickI));
+				IBrick ib(rb, brick, BrickIdentifier(block.index, i, placement.modelBlockI));
 				bricks[bricksSize++] = ib;
 			}
+			origBricks[placement.modelBlockI] = bricks[bricksSize - block.size].b; // The first brick of a block is at its origin.
+		}
+
+		/*
+		Removes the block added last by push() or add().
+		*/
+		void pop(const FatBlock &block) {
+			assert(bricksSize >= block.size);
+			bricksSize -= block.size;
 		}
 
 		Model(FatBlock const * const blocks, const util::TinyVector<AngledConnection, 5> &cs) : bricksSize(0) {
@@ -263,7 +263,7 @@ namespace modelling {
 		std::map<ConnectionPoint, IConnectionPair> connectionMaps[6];
 
 		// Assign connections to lists, then sort them:
-		for (std::set<IConnectionPair>::const_iterator it = list.begin(); it != list.end(); ++it) {
+		for (const IConnectionPair* it = list.begin(); it != list.end(); ++it) {
 			// Blow up the IConnectionPair:
 			const IConnectionPair &c = *it;
 			const IConnectionPoint &ip1 = c.first;
@@ -347,7 +347,7 @@ namespace modelling {
 		std::cout << "INIT testCodec(" << list1 << ")" << std::endl;
 #endif
 		util::TinyVector<AngledConnection, 5> cs;
-		for (std::set<IConnectionPair>::const_iterator it = list1.begin(); it != list1.end(); ++it)
+		for (const IConnectionPair* it = list1.begin(); it != list1.end(); ++it)
 			cs.push_back(AngledConnection(*it, StepAngle()));
 		Model c1(fatBlocks, cs);
 #ifdef _TRACE
@@ -372,7 +372,7 @@ namespace modelling {
 #endif
 
 		cs.clear();
-		for (std::set<IConnectionPair>::const_iterator it = list2.begin(); it != list2.end(); ++it)
+		for (const IConnectionPair* it = list2.begin(); it != list2.end(); ++it)
 			cs.push_back(AngledConnection(*it, StepAngle()));
 		Model c2(fatBlocks, cs);
 #ifdef _TRACE
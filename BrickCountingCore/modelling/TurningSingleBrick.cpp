@@ -110,20 +110,10 @@ namespace modelling {
 		return os;
 	}
 
-	void TurningSingleBrick::createBricksAndStudTranslation(const Model &model, const IConnectionPair &connectionPair, const RectilinearBrick &rb) {
-		int prevBrickI = connectionPair.P1.first.modelBlockI;
-		const Brick &prevOrigBrick = model.origBricks[prevBrickI];
-		const ConnectionPoint &prevPoint = connectionPair.P1.second;
-		const ConnectionPoint &currPoint = connectionPair.P2.second;
-		Brick prevBrick(prevOrigBrick, connectionPair.P1.second.brick);
-		studTranslation = prevBrick.getStudPosition(prevPoint.type);
-
-		double angle = prevBrick.angle + M_PI / 2 * (currPoint.type - prevPoint.type - 2);
-		int8_t level = prevOrigBrick.level + prevPoint.brick.level() + (prevPoint.above ? 1 : -1);
-
-		blocks[0] = Brick(rb, currPoint, geometry::Point(0, 0), angle - MAX_ANGLE_RADIANS, level);
-		blocks[1] = Brick(rb, currPoint, geometry::Point(0, 0), angle + MAX_ANGLE_RADIANS, level);
-		blockAbove = Brick(rb, currPoint, geometry::Point(0, 0), angle, level);
+	void TurningSingleBrick::createBricks(const RectilinearBrick &rb, const ConnectionPoint &point, double minAngle, double maxAngle) {
+		blocks[0] = Brick(rb, point, geometry::Point(0, 0), minAngle, 0);
+		blocks[1] = Brick(rb, point, geometry::Point(0, 0), maxAngle, 0);
+		blockAbove = Brick(rb, point, geometry::Point(0, 0), 0, 0);
 	}
 
 	void TurningSingleBrick::createMovingStuds() {
@@ -6,6 +6,9 @@
 #include "Model.hpp"
 #include <vector>
 
+// Number of tolerances a TurningBlockCache can hold:
+#define TURNING_BLOCK_CACHE_TOLERANCES 5
+
 namespace geometry {
 	double angleToOriginalInterval(double a, const RadianInterval &interval);
 	void intervalsToOriginalInterval(const IntervalList &l, const RadianInterval &interval, IntervalList &result);
@@ -161,16 +164,30 @@ namespace modelling {
 
 	std::ostream& operator<<(std::ostream &os, const MovingStud& ms);
 
+	/*
+	A brick of a block turning about a connection point. The TurningSingleBrick is in the system of the connection:
+	The stud of the connection is at the origin, the block is at level 0 and at angle 0 when the connection angle is 0.
+	Bricks checked against the TurningSingleBrick must be moved into this system. See TurningBlockInvestigator::toConnectionSystem().
+	*/
 	struct TurningSingleBrick {
 		Brick blocks[2];
 		Brick blockAbove;
 		Fan fans[6];
 		MovingStud movingStuds[NUMBER_OF_STUDS];
-		geometry::Point studTranslation;
 
-		void createBricksAndStudTranslation(const Model &model, const IConnectionPair &connectionPair, const RectilinearBrick &b);
+		/*
+		blocks[0] and blocks[1] are the brick turned to minAngle and maxAngle relative to the connection. Fans and moving studs sweep between them.
+		*/
+		void createBricks(const RectilinearBrick &b, const ConnectionPoint &point, double minAngle = -MAX_ANGLE_RADIANS, double maxAngle = MAX_ANGLE_RADIANS);
 		void createMovingStuds();
 
+		template <int ADD_XY>
+		void /*TurningSingleBrick::*/create(const RectilinearBrick &b, const ConnectionPoint &point, double minAngle = -MAX_ANGLE_RADIANS, double maxAngle = MAX_ANGLE_RADIANS) {
+			createBricks(b, point, minAngle, maxAngle);
+			createFans<ADD_XY>();
+			createMovingStuds();
+		}
+
 		template <int ADD_XY>
 		void /*TurningSingleBrick::*/createFans() {
 			geometry::Point pois1[NUMBER_OF_POIS_FOR_BOX_INTERSECTION];
@@ -360,17 +377,139 @@ namespace modelling {
 		}
 	};
 
+	/*
+	TurningSingleBricks of the bricks of a block turning through all angles of a connection, for the tolerances they are created for.
+	They are in the system of the connection, so they do not depend on the model which the block is connected to. They can thus be created once and used for all models.
+	*/
+	struct TurningBlockCache {
+	private:
+		int numTolerances;
+		int tolerances[TURNING_BLOCK_CACHE_TOLERANCES]; // ADD_XY of each entry of tsbs.
+		TurningSingleBrick tsbs[TURNING_BLOCK_CACHE_TOLERANCES][6];
+
+	public:
+		TurningBlockCache() : numTolerances(0) {}
+
+		void /*TurningBlockCache::*/clear() {
+			numTolerances = 0;
+		}
+
+		template <int ADD_XY>
+		void /*TurningBlockCache::*/create(const FatBlock &block, const ConnectionPoint &point) {
+			assert(numTolerances < TURNING_BLOCK_CACHE_TOLERANCES);
+			assert(get<ADD_XY>() == NULL);
+			RectilinearBrick b;
+			for (int i = 0; i < block.size; b = block.otherBricks[i++])
+				tsbs[numTolerances][i].create<ADD_XY>(b, point);
+			tolerances[numTolerances++] = ADD_XY;
+		}
+
+		/*
+		Returns the TurningSingleBricks created for ADD_XY, or NULL if they have not been created.
+		*/
+		template <int ADD_XY>
+		const TurningSingleBrick* /*TurningBlockCache::*/get() const {
+			for (int i = 0; i < numTolerances; ++i) {
+				if (tolerances[i] == ADD_XY)
+					return tsbs[i];
+			}
+			return NULL;
+		}
+	};
+
+	/*
+	Realizability of the turning block at the angle of a click for the tolerances -tolerance, 0 and tolerance (S, M and L).
+	*/
+	struct ClickVerification {
+		short angle; // StepAngle::n of the click.
+		int tolerance;
+		bool s, m, l;
+	};
+
 	struct TurningBlockInvestigator {
-		Model baseModel;
+		const Model &baseModel;
 		IConnectionPair connectionPair;
 		FatBlock block;
-
-		/*TurningBlockInvestigator::*/TurningBlockInvestigator() {}
-		/*TurningBlockInvestigator::*/TurningBlockInvestigator(const TurningBlockInvestigator &b) : baseModel(b.baseModel), connectionPair(b.connectionPair), block(b.block) {}
-		/*TurningBlockInvestigator::*/TurningBlockInvestigator(const Model &baseModel, const FatBlock &block, int modelBlockI, const IConnectionPair &connectionPair) : baseModel(baseModel), connectionPair(connectionPair), block(block) {
+		BlockPlacement placement;
+		double sinNegAngle, cosNegAngle; // Of placement.angle.
+		const TurningBlockCache *cache;
+		// Clicks are verified for S, M and L at once, and the verifications are reused by all calls of allowableAnglesForBricks():
+		mutable std::vector<ClickVerification> clickVerifications;
+		mutable uint64_t clickCacheHits, clickCacheMisses;
+
+		/*TurningBlockInvestigator::*/TurningBlockInvestigator(const TurningBlockInvestigator &b) : baseModel(b.baseModel), connectionPair(b.connectionPair), block(b.block), placement(b.placement), sinNegAngle(b.sinNegAngle), cosNegAngle(b.cosNegAngle), cache(b.cache), clickVerifications(b.clickVerifications), clickCacheHits(b.clickCacheHits), clickCacheMisses(b.clickCacheMisses) {}
+		/*
+		cache holds the TurningSingleBricks of block turning about the connection point, or is NULL if the TurningSingleBricks should be created when needed.
+		*/
+		/*TurningBlockInvestigator::*/TurningBlockInvestigator(const Model &baseModel, const FatBlock &block, int modelBlockI, const IConnectionPair &connectionPair, const TurningBlockCache *cache = NULL) : baseModel(baseModel), connectionPair(connectionPair), block(block), cache(cache), clickCacheHits(0), clickCacheMisses(0) {
 			if (modelBlockI == connectionPair.P1.first.modelBlockI) {
 				std::swap(this->connectionPair.P1, this->connectionPair.P2);
 			}
+			baseModel.getBlockPlacement(modelBlockI, connectionPair, placement);
+			sinNegAngle = sin(-placement.angle);
+			cosNegAngle = cos(-placement.angle);
+		}
+
+		/*
+		Moves brick of the base model into the system of the connection. See TurningSingleBrick.
+		*/
+		Brick /*TurningBlockInvestigator::*/toConnectionSystem(const Brick &brick) const {
+			const double x = brick.center.X - placement.stud.X;
+			const double y = brick.center.Y - placement.stud.Y;
+			return Brick(x*cosNegAngle - y*sinNegAngle, x*sinNegAngle + y*cosNegAngle, geometry::normalizeAngle(brick.angle - placement.angle), (int8_t)(brick.level - placement.level));
+		}
+
+		/*
+		Returns the TurningSingleBricks of the block turning from minAngle to maxAngle. They are taken from the cache if possible, or otherwise created in tsbs.
+		*/
+		template <int ADD_XY>
+		const TurningSingleBrick* /*TurningBlockInvestigator::*/getTurningSingleBricks(double minAngle, double maxAngle, TurningSingleBrick *tsbs) const {
+			if (cache != NULL && minAngle == -MAX_ANGLE_RADIANS && maxAngle == MAX_ANGLE_RADIANS) {
+				const TurningSingleBrick *cached = cache->get<ADD_XY>();
+				if (cached != NULL)
+					return cached;
+			}
+			RectilinearBrick b;
+			for (int i = 0; i < block.size; b = block.otherBricks[i++])
+				tsbs[i].create<ADD_XY>(b, placement.point, minAngle, maxAngle);
+			return tsbs;
+		}
+
+		/*
+		Returns whether the block at the angle of a click is realizable using isRealizable<ADD_XY>().
+		The block is checked for -|ADD_XY|, 0 and |ADD_XY| at once using Model::isRealizableSML(), so the checks for S, M and L of the same click are only performed once.
+		A check for ADD_XY = 0 can use the M of a verification for any tolerance.
+		*/
+		template <int ADD_XY>
+		bool /*TurningBlockInvestigator::*/isRealizableAtClick(const util::TinyVector<int, 5> &possibleCollisions, const StepAngle &angle) const {
+			const int tolerance = ADD_XY < 0 ? -ADD_XY : ADD_XY;
+			for (std::vector<ClickVerification>::const_iterator it = clickVerifications.begin(); it != clickVerifications.end(); ++it) {
+				if (it->angle != angle.n || (tolerance != 0 && it->tolerance != tolerance))
+					continue;
+				++clickCacheHits;
+				return ADD_XY < 0 ? it->s : (ADD_XY == 0 ? it->m : it->l);
+			}
+			++clickCacheMisses;
+
+			Model c2(baseModel);
+			c2.push(block, placement, angle.toRadians());
+			BrickSoA collisionBricks;
+			baseModel.getCollisionBricks(possibleCollisions, collisionBricks);
+			ClickVerification verification;
+			verification.angle = angle.n;
+			verification.tolerance = tolerance;
+			verification.s = verification.m = verification.l = true;
+			c2.isRealizableSML<(ADD_XY < 0 ? -ADD_XY : ADD_XY)>(collisionBricks, block.size, verification.s, verification.m, verification.l);
+			clickVerifications.push_back(verification);
+#ifdef _TRACE
+			if (!(ADD_XY < 0 ? verification.s : (ADD_XY == 0 ? verification.m : verification.l))) {
+				std::cout << " NOT REALIZABLE: " << c2 << std::endl;
+				MPDPrinter h;
+				h.add("Not realizable", &c2);
+				h.print("unrealizable");
+			}
+#endif
+			return ADD_XY < 0 ? verification.s : (ADD_XY == 0 ? verification.m : verification.l);
 		}
 
 		template <int ADD_XY>
@@ -378,22 +517,21 @@ namespace modelling {
 			geometry::IntervalList ret;
 			ret.push_back(geometry::Interval(-MAX_ANGLE_RADIANS, MAX_ANGLE_RADIANS));
 
-			RectilinearBrick b;
-			for (int i = 0; i < block.size; b = block.otherBricks[i++]) {
+			TurningSingleBrick created[6];
+			const TurningSingleBrick *tsbs = getTurningSingleBricks<ADD_XY>(-MAX_ANGLE_RADIANS, MAX_ANGLE_RADIANS, created);
+			Brick bricks[5];
+			for (unsigned int j = 0; j < possibleCollisions.size(); ++j)
+				bricks[j] = toConnectionSystem(baseModel.bricks[possibleCollisions[j]].b);
+
+			for (int i = 0; i < block.size; ++i) {
 #ifdef _TRACE
 				std::cout << "----------------- INITIATING ALLOWABLE ANGLES <" << ADD_XY << "> ----------------------" << std::endl;
 #endif
-				// Create TurningSingleBrick:
-				TurningSingleBrick tsb;
-				tsb.createBricksAndStudTranslation(baseModel, connectionPair, b);
-				tsb.createFans<ADD_XY>();
-				tsb.createMovingStuds();
+				const TurningSingleBrick &tsb = tsbs[i];
 
 				// Check all possible collision bricks:
-				for (const int* it = possibleCollisions.begin(); it != possibleCollisions.end(); ++it) {
-					Brick brick = baseModel.bricks[*it].b;
-					brick.center.X -= tsb.studTranslation.X;
-					brick.center.Y -= tsb.studTranslation.Y;
+				for (unsigned int j = 0; j < possibleCollisions.size(); ++j) {
+					const Brick &brick = bricks[j];
 
 					geometry::IntervalList joiner;
 					std::vector<ClickInfo> clicks;
@@ -408,11 +546,7 @@ namespace modelling {
 #ifdef _TRACE
 						std::cout << " Checking click, angle=" << it2->first << ", dist=" << it2->second << std::endl;
 #endif
-						Model c2(baseModel);
-						StepAngle stepAngle(it2->first);
-						AngledConnection connection(connectionPair, stepAngle);
-						c2.add(block, connectionPair.P2.first.modelBlockI, connection);
-						if (c2.isRealizable<ADD_XY>(possibleCollisions, block.size)) {
+						if (isRealizableAtClick<ADD_XY>(possibleCollisions, StepAngle(it2->first))) {
 							const double angleOfSnapRadius = it2->second;
 #ifdef _TRACE
 							std::cout << "  Adding stud interval " << Interval(it2->first - angleOfSnapRadius, it2->first + angleOfSnapRadius) << std::endl;
@@ -426,14 +560,6 @@ namespace modelling {
 							geometry::IntervalList copyRet2(ret); ret.clear();
 							geometry::intervalOr(copyRet2, studInterval, ret);
 						}
-#ifdef _TRACE
-						else {
-							std::cout << " NOT REALIZABLE: " << c2 << std::endl;
-							MPDPrinter h;
-							h.add("Not realizable", &c2);
-							h.print("unrealizable");
-						}
-#endif
 					}
 				}
 			}
@@ -449,21 +575,24 @@ namespace modelling {
 		*/
 		template <int ADD_XY>
 		bool /*TurningBlockInvestigator::*/isClear(const util::TinyVector<int, 5> &possibleCollisions) const {
-			RectilinearBrick b;
-			for (int i = 0; i < block.size; b = block.otherBricks[i++]) {
-				// Create TurningSingleBrick:
-				TurningSingleBrick tsb;
-				tsb.createBricksAndStudTranslation(baseModel, connectionPair, b);
-				tsb.createFans<ADD_XY>();
-				tsb.createMovingStuds();
+			return isClear<ADD_XY>(possibleCollisions, -MAX_ANGLE_RADIANS, MAX_ANGLE_RADIANS);
+		}
 
+		/*
+		As above, but only turning the block from minAngle to maxAngle. Used for certifying boxes of the SML matrix as clear.
+		*/
+		template <int ADD_XY>
+		bool /*TurningBlockInvestigator::*/isClear(const util::TinyVector<int, 5> &possibleCollisions, double minAngle, double maxAngle) const {
+			TurningSingleBrick created[6];
+			const TurningSingleBrick *tsbs = getTurningSingleBricks<ADD_XY>(minAngle, maxAngle, created);
+			Brick bricks[5];
+			for (unsigned int j = 0; j < possibleCollisions.size(); ++j)
+				bricks[j] = toConnectionSystem(baseModel.bricks[possibleCollisions[j]].b);
+
+			for (int i = 0; i < block.size; ++i) {
 				// Check all possible collision bricks:
-				for (const int* it = possibleCollisions.begin(); it != possibleCollisions.end(); ++it) {
-					Brick brick = baseModel.bricks[*it].b;
-					brick.center.X -= tsb.studTranslation.X;
-					brick.center.Y -= tsb.studTranslation.Y;
-
-					if (tsb.intersectsBrick<ADD_XY>(brick)) {
+				for (unsigned int j = 0; j < possibleCollisions.size(); ++j) {
+					if (tsbs[i].intersectsBrick<ADD_XY>(bricks[j])) {
 						return false;
 					}
 				}
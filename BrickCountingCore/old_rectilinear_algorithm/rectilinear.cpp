@@ -7,6 +7,9 @@
 #include <chrono>
 #include <thread>
 #include <sstream>
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
 
 #include "rectilinear.h"
 
@@ -837,7 +840,11 @@ namespace rectilinear {
   }
 		
   Brick CombinationReader::readBrick() {
-    return Brick(readBit(), readInt8(), readInt8());
+    // Read in the order written by CombinationWriter::writeBrick(). The order in which function arguments are evaluated is unspecified:
+    bool isVertical = readBit();
+    int8_t x = readInt8();
+    int8_t y = readInt8();
+    return Brick(isVertical, x, y);
   }
 
   CombinationReader::CombinationReader(const int layerSizes[], int Z) : height(0), Z(Z), token(0), bits(0), bitIdx(8), done(false), combinationCounter(0) {
@@ -895,6 +902,28 @@ namespace rectilinear {
     std::cout << "    READER for " << layerString << ": " << file_name << ", reversed: " << reverse << ", invalid: " << invalid << std::endl;
   }
 
+  /*
+    Read the combinations written to fileName using CombinationWriter::writeCombination(). They are read in the order they were written.
+   */
+  CombinationReader::CombinationReader(const std::string &fileName, const int layerSizes[], int Z) : height(0), Z(Z), token(0), bits(0), bitIdx(8), reverse(false), done(false), invalid(false), combinationCounter(0), name(fileName) {
+    int size_total = 0;
+    for(int i = 0; size_total < Z; i++) {
+      this->layerSizes[i] = layerSizes[i];
+      size_total += layerSizes[i];
+      height++;
+    }
+    for(int i = height-1; i >= 0; i--) {
+      token = token * 10 + layerSizes[i];
+    }
+    istream = new std::ifstream(fileName.c_str(), std::ios::binary);
+    if(!istream->good()) {
+      std::cerr << "Unable to read " << fileName << std::endl;
+      exit(1);
+    }
+    baseCombination.bricks[0][0] = FirstBrick;
+    combinationsLeft = 0;
+  }
+
   bool CombinationReader::isInvalid() const {
     return invalid;
   }
@@ -1065,7 +1094,42 @@ namespace rectilinear {
     }
   }
 
-  SpindleBuilder::SpindleBuilder(int token) {
+  CacheSpillFile::CacheSpillFile(int token) : reader(NULL), written(0) {
+    static std::atomic<int> spillCounter(0);
+    std::stringstream ss;
+    ss << "spindle_cache_" << token << "_" << (spillCounter++) << ".tmp";
+    fileName = ss.str();
+    Z = Combination::sizeOfToken(token);
+    Combination::getLayerSizesFromToken(token, layerSizes);
+    writer = new CombinationWriter(token, fileName);
+  }
+
+  CacheSpillFile::~CacheSpillFile() {
+    delete writer;
+    delete reader;
+    std::remove(fileName.c_str());
+  }
+
+  void CacheSpillFile::write(const Combination &c) {
+    writer->writeCombination(c);
+    written++;
+  }
+
+  void CacheSpillFile::rewind() {
+    delete writer; // Marks the end of the file and closes it.
+    writer = NULL;
+    reader = new CombinationReader(fileName, layerSizes, Z);
+  }
+
+  bool CacheSpillFile::read(Combination &c) {
+    return reader->nextCombination(c);
+  }
+
+  uint64_t CacheSpillFile::size() const {
+    return written;
+  }
+
+  SpindleBuilder::SpindleBuilder(int token, uint64_t memoryBudget) : smallerProducer(NULL), spill(NULL) {
     assert(canHandle(token));
     int height, Z, layerSizes[MAX_HEIGHT];
     std::vector<int> candidates;
@@ -1092,16 +1156,33 @@ namespace rectilinear {
     }
     // Set up cache:
     cacheIsLower = bestCandidateIsLower;
-    int cacheToken, smallerToken;
+    int cacheToken;
     splitTokenToTokens(layerSizes, height, bestCandidate, cacheToken, smallerToken);
     if(!cacheIsLower)
       std::swap(cacheToken, smallerToken);
+    // Each combination in the cache takes a Combination in cache and a bit in cacheSymmetric (rounded up to a byte).
+    // cacheSymmetric is reserved up front, so it does not grow past the budget by doubling.
+    cacheCapacity = memoryBudget / (sizeof(Combination) + 1);
+    if(cacheCapacity == 0)
+      cacheCapacity = 1;
+    cacheSymmetric.reserve(cacheCapacity);
     CombinationReader reader(&layerSizes[cacheIsLower ? 0 : bestCandidate], bestCandidateSize);
     while(reader.hasNextCombination()) {
       Combination c;
       reader.nextCombination(c);
+      if(spill != NULL) {
+	spill->write(c);
+	continue;
+      }
       cache.push_back(c);
       cacheSymmetric.push_back(c.is180Symmetric());
+      if(cache.size() >= cacheCapacity && reader.hasNextCombination())
+	spillCache(cacheToken);
+    }
+    if(spill != NULL) {
+      std::cout << "   Cache for <" << token << "> spilled " << spill->size() << " combinations of <" << cacheToken << "> to disk. Passes required: " << (spill->size() + cacheCapacity - 1) / cacheCapacity << std::endl;
+      spill->rewind();
+      nextCachePass(); // Loads the first part of the cache
     }
     cacheIndex = (int)cache.size();
 
@@ -1109,35 +1190,80 @@ namespace rectilinear {
     smallerProducer = ICombinationProducer::get(smallerToken);
   }
 
+  SpindleBuilder::~SpindleBuilder() {
+    delete smallerProducer;
+    if(spill != NULL)
+      delete spill;
+  }
+
+  /*
+    Move the cache to a spill file, so the remaining combinations can be written there as well.
+   */
+  void SpindleBuilder::spillCache(int cacheToken) {
+    spill = new CacheSpillFile(cacheToken);
+    for(unsigned int i = 0; i < cache.size(); i++)
+      spill->write(cache[i]);
+    cache.clear();
+    cacheSymmetric.clear();
+  }
+
+  /*
+    Read the next part of the spilled cache into memory.
+    The smaller producer is restarted for each pass, except for the first.
+   */
+  bool SpindleBuilder::nextCachePass() {
+    if(spill == NULL)
+      return false;
+    cache.clear();
+    cacheSymmetric.clear();
+    Combination c;
+    while(cache.size() < cacheCapacity && spill->read(c)) {
+      cache.push_back(c);
+      cacheSymmetric.push_back(c.is180Symmetric());
+    }
+    if(cache.empty())
+      return false;
+    if(smallerProducer != NULL) {
+      delete smallerProducer;
+      smallerProducer = ICombinationProducer::get(smallerToken);
+    }
+    cacheIndex = (int)cache.size();
+    return true;
+  }
+
   bool SpindleBuilder::nextCombination(Combination &c) {
     std::lock_guard<std::mutex> guard(read_mutex); // Ensure no update while reading
-    if(cacheIndex >= (int)cache.size()) {
-      bool ok = smallerProducer->nextCombination(smaller);
-      if(!ok)
+    while(cacheIndex >= (int)cache.size()) {
+      if(smallerProducer->nextCombination(smaller)) {
+	smallerSymmetric = smaller.is180Symmetric();
+	cacheIndex = 0;
+	produced = false;
+      }
+      else if(!nextCachePass()) {
 	return false;
-      smallerSymmetric = smaller.is180Symmetric();
-      cacheIndex = 0;
-      produced = false;
+      }
     }
 
     Combination &lower = cacheIsLower ? cache[cacheIndex] : smaller;
     Combination &upper = !cacheIsLower ? cache[cacheIndex] : smaller;
     if(!produced && !smallerSymmetric && !cacheSymmetric[cacheIndex]) {
-      upper.rotate180();
-      lower.stack(upper, c);
-      produced = true;
-      cacheIndex++;
+      Combination rotated(upper); // Do not rotate upper in place as it is reused by later passes
+      rotated.rotate180();
+      lower.stack(rotated, c);
+      produced = true; // Unrotated upper is produced in next call
       return true;
     }
     lower.stack(upper, c);
-    produced = smallerSymmetric || cacheSymmetric[cacheIndex];
-    if(produced)
-      cacheIndex++;
+    produced = false;
+    cacheIndex++;
     return true;
   }
 
   bool SpindleBuilder::hasNextCombination() {
-    return (cacheIndex < (int)cache.size()) || smallerProducer->hasNextCombination();
+    std::lock_guard<std::mutex> guard(read_mutex); // Ensure no update while reading
+    if(cacheIndex < (int)cache.size() || smallerProducer->hasNextCombination())
+      return true;
+    return nextCachePass() && smallerProducer->hasNextCombination();
   }
 
   bool SpindleBuilder::canHandle(int token) {
@@ -1198,6 +1324,18 @@ namespace rectilinear {
       ostream = NULL;
   }
 
+  /*
+    Write to fileName using writeCombination(). Used for the spill files of SpindleBuilder.
+   */
+  CombinationWriter::CombinationWriter(const int token, const std::string &fileName) : height(0), writtenFull(0), writtenShort(0), token(token), counts(), Z(0) {
+    ostream = new std::ofstream(fileName.c_str(), std::ios::binary);
+    bits = cntBits = 0;
+    if(!ostream->good()) {
+      std::cerr << "Unable to create " << fileName << std::endl;
+      exit(1);
+    }
+  }
+
   CombinationWriter::CombinationWriter(const CombinationWriter &cw) : ostream(cw.ostream), height(cw.height), writtenFull(0), writtenShort(0), token(cw.token), counts() {
     
   }
@@ -1212,6 +1350,10 @@ namespace rectilinear {
       writeUInt4(15); // Mark end of file.
       flushBits();
       ostream->flush();
+      if(!ostream->good()) {
+	std::cerr << "Unable to write combinations for " << token << std::endl;
+	exit(1);
+      }
       ostream->close();
       delete ostream;
     }
@@ -1453,6 +1595,21 @@ namespace rectilinear {
     }
   }
 
+  /*
+    Write c on its own: The last brick of its top layer is written as the only brick added to the rest of c.
+    CombinationReader normalizes the combinations it reads, so c must be normalized in order to be read back unchanged.
+   */
+  void CombinationWriter::writeCombination(const Combination &c) {
+    const int top = c.height-1;
+    const int s = c.layerSizes[top];
+    Combination base(c);
+    base.layerSizes[top] = s-1;
+    if(s == 1)
+      base.height--;
+    std::vector<Brick> v(1, c.bricks[top][s-1]);
+    writeCombinations(base, top, v);
+  }
+
   bool CombinationWriter::writesToFile() const {
     return ostream != NULL;
   }
@@ -1462,6 +1619,15 @@ namespace rectilinear {
     cache[Combination::reverseToken(token)] = counts;
   }
 
+  /*
+    Machine-readable line for the refinement aggregator (see rectilinear_refinements):
+    REFINEMENT <token> <all> <symmetric180> <seconds>
+   */
+  void Counter::reportRefinement(int token, const Counts &counts, std::chrono::time_point<std::chrono::steady_clock> t_init) {
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - t_init;
+    std::cout << "REFINEMENT " << token << " " << counts.all << " " << counts.symmetric180 << " " << t.count() << std::endl;
+  }
+
   Counts Counter::fastRunToWriter(CombinationWriter &writer) {
     Counts counts;
     int height = Combination::heightOfToken(writer.token);
@@ -1479,7 +1645,8 @@ namespace rectilinear {
       int smallerToken = Combination::getTokenFromLayerSizes(layerSizes, smallerHeight);
       ICombinationProducer *reader = ICombinationProducer::get(smallerToken);
 
-      unsigned int processor_count = std::thread::hardware_concurrency() - 2; // allow 2 processors for OS and other...
+      unsigned int processor_count = std::thread::hardware_concurrency();
+      processor_count = processor_count > 2 ? processor_count - 2 : 1; // allow 2 processors for OS and other...
       if(!writer.writesToFile() && processor_count > 1) {
 	std::cout << "   Splitting computation into " << processor_count << " threads" << std::endl;
 	// Fill from readers in threads:
@@ -1517,21 +1684,24 @@ namespace rectilinear {
 
     if(remaining == 0) {
       std::cout << " Handling combinations for token " << token << std::endl;
+      std::chrono::time_point<std::chrono::steady_clock> t_init = std::chrono::steady_clock::now();
       if(!saveOutput) {
 	// Try to count quickly when no data is saved to disk:
 	// 0: See if token is in cache:
 	if(cache.find(token) != cache.end()) {
 	  counts = cache[token];
 	  std::cout << "  Cache -> " << counts << " for token " << token << std::endl;
+	  reportRefinement(token, counts, t_init);
 	  return counts;
 	}
-	// 1: Lemma 1:
+	// 1: Lemma 1, if the smaller refinements have been counted by this run:
+	int height, Z, layerSizes[MAX_HEIGHT], lowerToken = 0, upperToken = 0;
 	if(SpindleBuilder::canHandle(token)) {
-	  int height, Z, layerSizes[MAX_HEIGHT];
 	  std::vector<int> candidates;
 	  SpindleBuilder::setup(token, height, Z, layerSizes, candidates);
-	  int lowerToken, upperToken;
 	  SpindleBuilder::splitTokenToTokens(layerSizes, height, candidates[0], lowerToken, upperToken);
+	}
+	if(cache.find(lowerToken) != cache.end() && cache.find(upperToken) != cache.end()) {
 	  Counts C = cache[lowerToken];
 	  Counts D = cache[upperToken];
 	  uint64_t dn = D.all - D.symmetric180;
@@ -1543,6 +1713,7 @@ namespace rectilinear {
 	  counts.symmetric180 = cs * ds;
 	  std::cout << "  Lemma 1 -> " << counts << " for token " << token << std::endl;
 	  writeToCache(token, counts);
+	  reportRefinement(token, counts, t_init);
 	  return counts;
 	}
       }
@@ -1551,6 +1722,7 @@ namespace rectilinear {
 
       std::cout << "  Constructed " << counts << " combinations for token " << token << std::endl;
       writeToCache(token, counts);
+      reportRefinement(token, counts, t_init);
       return counts;
     }
 
@@ -1779,9 +1951,11 @@ namespace rectilinear {
     // Special case handling:
     if(height >= 2 && input[0] >= '2' && input[1] == '2') {
       std::cout << "Special case <X2...>, X >= 2" << std::endl;
+      std::chrono::time_point<std::chrono::steady_clock> t_init = std::chrono::steady_clock::now();
       const int layer0Size = input[0]-'0';
       Counts counts = countX2(Z, layer0Size, input);
       writeToCache(token, counts);
+      reportRefinement(token, counts, t_init);
       return counts;
     }
     else { // Normal case:
@@ -10,6 +10,10 @@
 #define MAX_HEIGHT 6
 // At most 9 bricks can be in a single layer if we consider 11 to be maximal number of bricks
 #define MAX_LAYER_SIZE 9
+// Memory (in bytes) a SpindleBuilder may use for its cache before it spills to disk. Override with -DSPINDLE_CACHE_BUDGET=...
+#ifndef SPINDLE_CACHE_BUDGET
+#define SPINDLE_CACHE_BUDGET (8ull*1024*1024*1024)
+#endif
 
 #include "stdint.h"
 #include <stdarg.h>
@@ -18,6 +22,10 @@
 #include <set>
 #include <map>
 #include <mutex>
+#include <vector>
+#include <deque>
+#include <stack>
+#include <chrono>
 
 namespace rectilinear {
 
@@ -133,7 +141,7 @@ namespace rectilinear {
 
   class ICombinationProducer {
   public:
-    //virtual ~ICombinationProducer();
+    virtual ~ICombinationProducer() {}
     virtual bool nextCombination(Combination &c) = 0;
     virtual bool hasNextCombination() = 0;
     static ICombinationProducer* get(int token);
@@ -159,6 +167,7 @@ namespace rectilinear {
     void ensureCombinationsLeft();
   public:
     CombinationReader(const int layerSizes[], int Z);
+    CombinationReader(const std::string &fileName, const int layerSizes[], int Z);
     ~CombinationReader();
     bool nextCombination(Combination &c);
     bool hasNextCombination();
@@ -185,18 +194,45 @@ namespace rectilinear {
     static Counts addBricksToCombination(Combination &c, const int layer, std::vector<Brick> &v);
   };
 
+  class CombinationWriter;
+
+  /**
+   * Sequential temporary file for the cache of a SpindleBuilder when the cache exceeds the memory budget.
+   * Combinations are written by a CombinationWriter and read back in passes by a CombinationReader.
+   */
+  class CacheSpillFile {
+    std::string fileName;
+    int layerSizes[MAX_HEIGHT], Z;
+    CombinationWriter *writer; // NULL once rewound
+    CombinationReader *reader; // NULL until rewound
+    uint64_t written;
+  public:
+    CacheSpillFile(int token);
+    ~CacheSpillFile();
+    void write(const Combination &c);
+    void rewind(); // Closes the file for writing and starts reading from the beginning of it.
+    bool read(Combination &c);
+    uint64_t size() const;
+  };
+
   class SpindleBuilder final : public ICombinationProducer {
-    std::vector<Combination> cache;
+    std::deque<Combination> cache; // Grows in blocks without copying, so a full cache does not exceed the budget
     std::vector<bool> cacheSymmetric;
-    int cacheIndex;
+    int cacheIndex, smallerToken;
     bool cacheIsLower, produced;
     ICombinationProducer *smallerProducer;
     Combination smaller;
     bool smallerSymmetric;
     std::mutex read_mutex;
+    uint64_t cacheCapacity; // Number of combinations allowed in memory
+    CacheSpillFile *spill; // NULL unless the cache exceeds cacheCapacity
+
+    void spillCache(int token);
+    bool nextCachePass();
 
   public:
-    SpindleBuilder(int token);
+    SpindleBuilder(int token, uint64_t memoryBudget = SPINDLE_CACHE_BUDGET);
+    ~SpindleBuilder();
     bool nextCombination(Combination &c);
     bool hasNextCombination();
     static bool canHandle(int token);
@@ -217,11 +253,13 @@ namespace rectilinear {
     int Z;
 
     CombinationWriter(const int token, const bool saveOutput);
+    CombinationWriter(const int token, const std::string &fileName);
     CombinationWriter(const CombinationWriter &cw);
     ~CombinationWriter();
 
     bool writesToFile() const;
     void fillFromReader(int const * const layerSizes, const int reducedLayer, ICombinationProducer *reader);
+    void writeCombination(const Combination &c);
   private:
     void writeBit(bool bit);
     void flushBits();
@@ -236,6 +274,7 @@ namespace rectilinear {
     std::map<int,Counts> cache;
 
     void writeToCache(int token, Counts counts);
+    void reportRefinement(int token, const Counts &counts, std::chrono::time_point<std::chrono::steady_clock> t_init);
     Counts fastRunToWriter(CombinationWriter &writer);
     Counts buildCombinations(int token, int remaining, bool add_self, bool saveOutput);
 
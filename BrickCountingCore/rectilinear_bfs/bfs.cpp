@@ -512,6 +512,14 @@ namespace rectilinear {
     layerSizes[layer]++;
   }
 
+  bool Combination::fitsIn(const uint8_t *maxLayerSizes) const {
+    for(uint8_t i = 0; i < height; i++) {
+      if(layerSizes[i] > maxLayerSizes[i])
+	return false;
+    }
+    return true;
+  }
+
   void Combination::removeLastBrick() {
 #ifdef PROFILING
     Profiler::countInvocation("Combination::removeLastBrick()");
@@ -590,8 +598,9 @@ namespace rectilinear {
   CombinationBuilder::CombinationBuilder(Combination &c,
 					 const uint8_t waveStart,
 					 const uint8_t waveSize,
-					 const uint8_t maxSize) :
-    baseCombination(c), waveStart(waveStart), waveSize(waveSize), maxSize(maxSize) {
+					 const uint8_t maxSize,
+					 const uint8_t *maxLayerSizes) :
+    baseCombination(c), waveStart(waveStart), waveSize(waveSize), maxSize(maxSize), maxLayerSizes(maxLayerSizes) {
 #ifdef PROFILING
     Profiler::countInvocation("CombinationBuilder::CombinationBuilder(Combination, uint8_t, uint8_t, uint8_t)");
 #endif
@@ -712,7 +721,10 @@ namespace rectilinear {
 	  std::cout << "  Building on " << baseCombination << std::endl;
 	}
 
-	if(toPick == leftToPlace) {
+	if(maxLayerSizes != NULL && !baseCombination.fitsIn(maxLayerSizes)) {
+	  // Layers only grow, so the refinement being counted can not be reached:
+	}
+	else if(toPick == leftToPlace) {
 	  int token = baseCombination.getTokenFromLayerSizes();
 	  Counts cx;
 	  cx.all++;
@@ -729,7 +741,7 @@ namespace rectilinear {
 	}
 	else { // toPick < leftToPlace)
 	  // Recurse:
-	  CombinationBuilder builder(baseCombination, waveStart+waveSize, toPick, maxSize);
+	  CombinationBuilder builder(baseCombination, waveStart+waveSize, toPick, maxSize, maxLayerSizes);
 	  builder.build();
 
 	  for(CountsMap::iterator it = builder.counts.begin(); it != builder.counts.end(); it++) {
@@ -788,8 +800,11 @@ namespace rectilinear {
       countsForToken.all += countsForToken.symmetric180;
       countsForToken.all /= 2 * layerSizes[0];
       countsForToken.symmetric180 /= layerSizes[0];
-      countsForToken.symmetric90 /= layerSizes[0] / 2;
+      if(layerSizes[0] > 1)
+	countsForToken.symmetric90 /= layerSizes[0] / 2;
       std::cout << " <" << token << "> " << countsForToken << std::endl;
+      // Machine-readable line for the refinement aggregator. Refinements are not timed individually:
+      std::cout << "REFINEMENT " << token << " " << countsForToken.all << " " << countsForToken.symmetric180 << " -" << std::endl;
       total += countsForToken;
     }
 
@@ -17,6 +17,7 @@
 #include <fstream>
 #include <map>
 #include <mutex>
+#include <vector>
 
 #ifdef PROFILING
 typedef std::pair<uint64_t,std::string> InvocationPair;
@@ -125,6 +126,7 @@ namespace rectilinear {
     void translateMinToOrigo();
     void addBrick(const Brick &b, const uint8_t layer);
     void removeLastBrick();
+    bool fitsIn(const uint8_t *maxLayerSizes) const;
     int getTokenFromLayerSizes() const;
     static int reverseToken(int token);
     static uint8_t heightOfToken(int token);
@@ -136,9 +138,10 @@ namespace rectilinear {
   public:
     Combination &baseCombination;
     const uint8_t waveStart, waveSize, maxSize;
+    const uint8_t *maxLayerSizes; // NULL unless only counting a single refinement
     CountsMap counts; // token -> counts
 
-    CombinationBuilder(Combination &c, const uint8_t waveStart, const uint8_t waveSize, const uint8_t maxSize);
+    CombinationBuilder(Combination &c, const uint8_t waveStart, const uint8_t waveSize, const uint8_t maxSize, const uint8_t *maxLayerSizes = NULL);
 
     void build();
     void report();
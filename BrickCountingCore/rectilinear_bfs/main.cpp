@@ -1,5 +1,6 @@
 #include <iostream>
 #include <stdlib.h>
+#include <chrono>
 #include "bfs.h"
 
 #ifdef PROFILING
@@ -16,21 +17,33 @@
 */
 int main(int argc, char** argv) {
   if(argc != 2) {
-    std::cout << "Usage: Run without arguments to count models up to size given as parameter." << std::endl;
+    std::cout << "Usage: Specify the size of the models to count, or a refinement like 221 to only count models of <221>." << std::endl;
     return 1;
   }
 
-  int n = 0;
+  int n = 0, height = 0;
+  uint8_t maxLayerSizes[MAX_BRICKS] = {};
   char c;
   for(int i = 0; (c = argv[1][i]); i++) {
     n += (c-'0');
+    if(i < MAX_BRICKS)
+      maxLayerSizes[i] = c-'0';
+    height++;
   }
 
-  std::cout << "Building models for size " << n << std::endl;
   rectilinear::Combination combination;
-  rectilinear::CombinationBuilder b(combination, 0, 1, n);
+  if(height > 1) {
+    std::cout << "Building models for refinement <" << argv[1] << "> of size " << n << std::endl;
+  }
+  else {
+    std::cout << "Building models for size " << n << std::endl;
+  }
+  rectilinear::CombinationBuilder b(combination, 0, 1, n, height > 1 ? maxLayerSizes : NULL);
+  std::chrono::time_point<std::chrono::steady_clock> t_init = std::chrono::steady_clock::now();
   b.build();
+  std::chrono::duration<double> t = std::chrono::steady_clock::now() - t_init;
   b.report();
+  std::cout << "RUNTIME " << n << " " << t.count() << std::endl;
 
 #ifdef PROFILING
   Profiler::reportInvocations();
@@ -0,0 +1,186 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "crosscheck.h"
+
+namespace rectilinear {
+
+  namespace {
+    /*
+      All tokens of the given size with at least 2 layers. Only one of <Z1..Zh> and <Zh..Z1> is included.
+     */
+    void addTokensOfSize(const std::string &prefix, int remaining, std::vector<std::string> &tokens) {
+      if(remaining == 0) {
+	if(prefix.size() > 1 && prefix >= RefinementAggregator::reverseToken(prefix))
+	  tokens.push_back(prefix);
+	return;
+      }
+      for(int z = 1; z <= remaining && z <= MAX_LAYER_SIZE; z++)
+	addTokensOfSize(prefix + (char)('0' + z), remaining - z, tokens);
+    }
+
+    std::string toString(const EngineRun &r) {
+      if(!r.ok)
+	return "-";
+      std::stringstream ss;
+      ss << r.counts;
+      return ss.str();
+    }
+  }
+
+  const char* CounterCrossCheck::engineName(Engine engine) {
+    return engine == BFS ? "BFS" : "OLD";
+  }
+
+  /*
+    Arguments of a single digit are sizes, while longer arguments are refinements, such as 221.
+   */
+  bool CounterCrossCheck::parseTokens(int argc, char** argv, std::vector<std::string> &tokens) {
+    for(int i = 0; i < argc; i++) {
+      std::string arg(argv[i]);
+      if(arg.empty() || arg.find_first_not_of("123456789") != std::string::npos) {
+	std::cout << "Not a size or refinement: " << arg << std::endl;
+	return false;
+      }
+      if(arg.size() == 1)
+	addTokensOfSize("", arg[0] - '0', tokens);
+      else if(RefinementAggregator::sizeOfToken(arg) > MAX_SIZE) {
+	std::cout << "Refinement <" << arg << "> is larger than " << MAX_SIZE << std::endl;
+	return false;
+      }
+      else
+	tokens.push_back(arg);
+    }
+    return true;
+  }
+
+  EngineRun CounterCrossCheck::run(Engine engine, const std::string &token) const {
+    EngineRun ret;
+    ret.ok = false;
+    std::string command = std::string("(cd ") + (engine == BFS ? BFS_COUNTER_DIR : OLD_COUNTER_DIR) +
+      " && ./run.o " + token + ") > " + CROSSCHECK_OUTPUT_FILE + " 2>&1";
+
+    std::chrono::time_point<std::chrono::steady_clock> t_init = std::chrono::steady_clock::now();
+    int status = std::system(command.c_str());
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - t_init;
+    ret.seconds = duration.count();
+    if(status != 0)
+      std::cout << " " << engineName(engine) << " counter exited with status " << status << " for <" << token << ">" << std::endl;
+
+    // Counters may report other refinements as well, so only the line for the token (or its reverse) is used:
+    std::string reversed = RefinementAggregator::reverseToken(token);
+    std::ifstream is(CROSSCHECK_OUTPUT_FILE);
+    std::string line, t, time, missingFile;
+    RefinementCounts c;
+    while(std::getline(is, line)) {
+      if(RefinementAggregator::parseRefinement(line, t, c, time) && (t == token || t == reversed)) {
+	ret.counts = c;
+	ret.ok = true;
+      }
+      // The old counter falls back to a backup reader when the file of a smaller refinement is missing. Its counts are then wrong:
+      size_t pos = line.find(MISSING_FILE_MESSAGE);
+      if(engine == OLD && pos != std::string::npos && missingFile.empty()) {
+	std::istringstream ss(line.substr(pos + std::string(MISSING_FILE_MESSAGE).size()));
+	ss >> missingFile;
+	if(!missingFile.empty() && missingFile[missingFile.size()-1] == '!')
+	  missingFile.erase(missingFile.size()-1);
+      }
+    }
+    is.close();
+    std::remove(CROSSCHECK_OUTPUT_FILE);
+    if(!missingFile.empty()) {
+      std::cout << " OLD counter is missing the saved models of <" << missingFile << "> in " << OLD_COUNTER_DIR
+		<< " for <" << token << ">. Save the smaller refinements first as described in README.md" << std::endl;
+      ret.ok = false;
+    }
+    return ret;
+  }
+
+  bool CounterCrossCheck::compare(const std::vector<std::string> &tokens) {
+    std::ofstream routing(ROUTING_FILE);
+    int mismatches = 0, missing = 0;
+    double bfsTotal = 0, oldTotal = 0, hybridTotal = 0;
+
+    std::cout << std::left << std::setw(12) << "Token" << std::setw(22) << "BFS" << std::setw(22) << "OLD"
+	      << std::setw(12) << "BFS s" << std::setw(12) << "OLD s" << "Result" << std::endl;
+    for(std::vector<std::string>::const_iterator it = tokens.begin(); it != tokens.end(); it++) {
+      const std::string &token = *it;
+      EngineRun bfs = run(BFS, token);
+      EngineRun old = run(OLD, token);
+
+      std::string result;
+      if(!bfs.ok || !old.ok) {
+	result = "MISSING";
+	missing++;
+      }
+      else if(bfs.counts != old.counts) {
+	result = "MISMATCH";
+	mismatches++;
+      }
+      else
+	result = "OK";
+
+      // Only route to the old counter when it agrees with the BFS counter:
+      Engine faster = (result == "OK" && old.seconds < bfs.seconds) ? OLD : BFS;
+      std::cout << std::setw(12) << token << std::setw(22) << toString(bfs) << std::setw(22) << toString(old)
+		<< std::setw(12) << bfs.seconds << std::setw(12) << old.seconds << result << " " << engineName(faster) << std::endl;
+      routing << "ROUTE " << token << " " << engineName(faster) << " " << bfs.seconds << " " << old.seconds << std::endl;
+
+      bfsTotal += bfs.seconds;
+      oldTotal += old.seconds;
+      hybridTotal += faster == BFS ? bfs.seconds : old.seconds;
+    }
+    routing.close();
+
+    std::cout << std::endl << "Total time: BFS " << bfsTotal << "s, OLD " << oldTotal << "s, hybrid " << hybridTotal << "s" << std::endl;
+    std::cout << tokens.size() << " refinements, " << mismatches << " mismatches, " << missing << " missing. Routing saved to " << ROUTING_FILE << std::endl;
+    return mismatches == 0 && missing == 0;
+  }
+
+  void CounterCrossCheck::readRoutes() {
+    std::ifstream is(ROUTING_FILE);
+    std::string line;
+    while(std::getline(is, line)) {
+      std::istringstream ss(line);
+      std::string type, token, engine;
+      ss >> type >> token >> engine;
+      if(type != "ROUTE" || ss.fail())
+	continue;
+      routes[token] = engine == "OLD" ? OLD : BFS;
+      routes[RefinementAggregator::reverseToken(token)] = routes[token];
+    }
+    is.close();
+  }
+
+  /*
+    Counts each refinement using the engine recorded as faster by compare(). The BFS counter is used for refinements without a route.
+    The output can be given to the aggregator.
+   */
+  bool CounterCrossCheck::hybrid(const std::vector<std::string> &tokens) {
+    readRoutes();
+    std::cout << "Read " << routes.size() << " routes from " << ROUTING_FILE << std::endl;
+
+    bool ok = true;
+    double total = 0;
+    for(std::vector<std::string>::const_iterator it = tokens.begin(); it != tokens.end(); it++) {
+      const std::string &token = *it;
+      std::map<std::string,Engine>::const_iterator route = routes.find(token);
+      Engine engine = route == routes.end() ? BFS : route->second;
+      EngineRun r = run(engine, token);
+      total += r.seconds;
+      if(!r.ok) {
+	std::cout << " " << engineName(engine) << " counter did not report <" << token << ">" << std::endl;
+	ok = false;
+	continue;
+      }
+      std::cout << "REFINEMENT " << token << " " << r.counts.all() << " " << r.counts.s << " " << r.seconds << " " << engineName(engine) << std::endl;
+    }
+    std::cout << "Hybrid run of " << tokens.size() << " refinements: " << total << "s" << std::endl;
+    return ok;
+  }
+}
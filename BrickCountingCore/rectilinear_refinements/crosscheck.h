@@ -0,0 +1,52 @@
+#ifndef CROSSCHECK_H
+#define CROSSCHECK_H
+
+// Folders of the two counters. Both are expected to have been compiled to run.o
+#ifndef BFS_COUNTER_DIR
+#define BFS_COUNTER_DIR "../rectilinear_bfs"
+#endif
+#ifndef OLD_COUNTER_DIR
+#define OLD_COUNTER_DIR "../old_rectilinear_algorithm"
+#endif
+// Written by COMPARE and read by HYBRID: The faster engine for each refinement.
+#define ROUTING_FILE "routing.txt"
+#define CROSSCHECK_OUTPUT_FILE "crosscheck_output.tmp"
+// Printed by the old counter when the file with the models of a smaller refinement is missing:
+#define MISSING_FILE_MESSAGE "Backup reader starting for token "
+
+#include <string>
+#include <vector>
+#include <map>
+#include "refinements.h"
+
+namespace rectilinear {
+
+  enum Engine {BFS, OLD};
+
+  struct EngineRun {
+    bool ok; // False if the counter did not report the refinement
+    RefinementCounts counts;
+    double seconds; // Wall time of the counter process
+  };
+
+  /**
+   * Runs the BFS counter and the old rectilinear counter on the same refinements.
+   *
+   * The counters both define their types in the rectilinear namespace, so they are run as separate processes
+   * and their REFINEMENT lines are parsed from the output.
+   */
+  class CounterCrossCheck {
+    std::map<std::string,Engine> routes;
+
+    EngineRun run(Engine engine, const std::string &token) const;
+    void readRoutes();
+
+  public:
+    bool compare(const std::vector<std::string> &tokens); // Returns true if both counters reported all refinements with the same counts.
+    bool hybrid(const std::vector<std::string> &tokens); // Returns true if all refinements were counted.
+    static bool parseTokens(int argc, char** argv, std::vector<std::string> &tokens);
+    static const char* engineName(Engine engine);
+  };
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "refinements.h"
+#include "crosscheck.h"
+
+/*
+  Assembles the per-refinement outputs of the counters (old_rectilinear_algorithm and rectilinear_bfs)
+  into totals per size and compares them to the known totals a(1), ..., a(6).
+  The exit code is 0 when all refinements up to the maximal size are known, no totals differ and no refinements are reported with different counts.
+
+  COMPARE runs both counters on the given sizes or refinements and compares the counts.
+  HYBRID counts the refinements using the faster counter found by COMPARE.
+*/
+int main(int argc, char** argv) {
+  if(argc < 3) {
+    std::cout << "Usage: Specify the maximal size followed by files with counter output, such as: ./run.o 6 known_refinements.txt bfs_6.txt" << std::endl;
+    std::cout << "Or compare the counters using COMPARE followed by sizes and refinements, such as: ./run.o COMPARE 4 221" << std::endl;
+    std::cout << "Or count using the faster counter for each refinement: ./run.o HYBRID 4 221" << std::endl;
+    return 1;
+  }
+
+  std::string mode(argv[1]);
+  if(mode == "COMPARE" || mode == "HYBRID") {
+    std::vector<std::string> tokens;
+    if(!rectilinear::CounterCrossCheck::parseTokens(argc-2, argv+2, tokens))
+      return 1;
+    rectilinear::CounterCrossCheck crossCheck;
+    bool ok = mode == "COMPARE" ? crossCheck.compare(tokens) : crossCheck.hybrid(tokens);
+    return ok ? 0 : 1;
+  }
+
+  int maxSize = atoi(argv[1]);
+  if(maxSize < 1 || maxSize > MAX_SIZE) {
+    std::cout << "Size must be between 1 and " << MAX_SIZE << std::endl;
+    return 1;
+  }
+
+  rectilinear::RefinementAggregator aggregator;
+  for(int i = 2; i < argc; i++) {
+    if(!aggregator.readFile(argv[i]))
+      return 1;
+  }
+
+  bool ok = aggregator.report(maxSize);
+  aggregator.reportEilers(maxSize);
+
+  std::cout << std::endl << (ok ? "All totals OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+#include "stdint.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <assert.h>
+
+#include "refinements.h"
+
+namespace rectilinear {
+
+  // Known totals a(n) from Eilers (2016):
+  const uint64_t KnownTotals[7] = {0, 1, 24, 1560, 119580, 10166403, 915103765};
+
+  RefinementCounts::RefinementCounts() : n(0), s(0) {
+  }
+  RefinementCounts::RefinementCounts(uint64_t n, uint64_t s) : n(n), s(s) {
+  }
+  RefinementCounts::RefinementCounts(const RefinementCounts &c) : n(c.n), s(c.s) {
+  }
+  uint64_t RefinementCounts::all() const {
+    return n + s;
+  }
+  bool RefinementCounts::operator ==(const RefinementCounts &c) const {
+    return n == c.n && s == c.s;
+  }
+  bool RefinementCounts::operator !=(const RefinementCounts &c) const {
+    return !(*this == c);
+  }
+  std::ostream& operator << (std::ostream &os, const RefinementCounts &c) {
+    os << c.all() << " (" << c.s << ")";
+    return os;
+  }
+
+  RefinementAggregator::RefinementAggregator() : conflict(false) {
+    setupAXX();
+  }
+
+  /*
+    A(X,X) for <11...1>:
+    An(X,X) = 46*An(X-1,X-1) + 6*2^X - 2^(X-1)
+    As(X,X) = 2^(X-1)
+   */
+  void RefinementAggregator::setupAXX() {
+    add("1", RefinementCounts(0, 1), "A(X,X)");
+    std::string token = "11";
+    uint64_t n = 22, s = 2;
+    for(int x = 2; x <= MAX_SIZE; x++) {
+      add(token, RefinementCounts(n, s), "A(X,X)");
+      token += "1";
+      n = 46*n + 6*((uint64_t)1 << (x+1)) - ((uint64_t)1 << x);
+      s *= 2;
+    }
+  }
+
+  std::string RefinementAggregator::reverseToken(const std::string &token) {
+    std::string ret(token);
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+  }
+
+  int RefinementAggregator::sizeOfToken(const std::string &token) {
+    int ret = 0;
+    for(unsigned int i = 0; i < token.size(); i++)
+      ret += token[i] - '0';
+    return ret;
+  }
+
+  /*
+    Parses a line "REFINEMENT <token> <all> <symmetric180> <seconds or ->".
+    Returns false for other lines.
+   */
+  bool RefinementAggregator::parseRefinement(const std::string &line, std::string &token, RefinementCounts &c, std::string &time) {
+    std::istringstream ss(line);
+    std::string type;
+    ss >> type;
+    if(type != "REFINEMENT")
+      return false;
+    uint64_t all, symmetric180;
+    ss >> token >> all >> symmetric180 >> time;
+    if(ss.fail() || all < symmetric180)
+      return false;
+    c = RefinementCounts(all - symmetric180, symmetric180);
+    return true;
+  }
+
+  /*
+    Returns false if the counts conflict with counts already seen for the token or its reverse.
+   */
+  bool RefinementAggregator::add(const std::string &token, const RefinementCounts &c, const std::string &source) {
+    RefinementCounts seen;
+    if(lookup(token, seen)) {
+      if(seen != c) {
+	std::string other = counts.find(token) != counts.end() ? token : reverseToken(token);
+	std::cout << "CONFLICT for <" << token << ">: " << c << " from " << source << " vs " << seen << " for <" << other << "> from " << sources[other] << std::endl;
+	conflict = true;
+	return false;
+      }
+      return true;
+    }
+    counts[token] = c;
+    sources[token] = source;
+    return true;
+  }
+
+  bool RefinementAggregator::readFile(const std::string &fileName) {
+    std::ifstream is(fileName.c_str());
+    if(!is.good()) {
+      std::cout << "Unable to read " << fileName << std::endl;
+      return false;
+    }
+    std::string line;
+    int lines = 0;
+    while(std::getline(is, line)) {
+      std::istringstream ss(line);
+      std::string type;
+      ss >> type;
+      if(type == "REFINEMENT") {
+	std::string token, time;
+	RefinementCounts c;
+	if(!parseRefinement(line, token, c, time)) {
+	  std::cout << "Malformed line in " << fileName << ": " << line << std::endl;
+	  continue;
+	}
+	add(token, c, fileName);
+	if(!time.empty() && time != "-")
+	  seconds[token] = atof(time.c_str());
+	lines++;
+      }
+      else if(type == "RUNTIME") {
+	int size;
+	double t;
+	ss >> size >> t;
+	if(!ss.fail())
+	  runtimes[size] = t;
+      }
+    }
+    is.close();
+    std::cout << "Read " << lines << " refinements from " << fileName << std::endl;
+    return true;
+  }
+
+  bool RefinementAggregator::lookup(const std::string &token, RefinementCounts &c) const {
+    std::map<std::string,RefinementCounts>::const_iterator it = counts.find(token);
+    if(it == counts.end())
+      it = counts.find(reverseToken(token));
+    if(it == counts.end())
+      return false;
+    c = it->second;
+    return true;
+  }
+
+  /*
+    Lemma 1: Split <C1D> at the layer of size 1 into <C1> and <1D>:
+    S = cs*ds
+    N = (dn+d)*cn + d*cs - cs*ds, where d = dn+ds
+   */
+  bool RefinementAggregator::derive(const std::string &token, RefinementCounts &c) {
+    if(token.size() == 1) {
+      c = RefinementCounts(); // More than one brick in a single layer can not be connected.
+      return sizeOfToken(token) > 1;
+    }
+    for(unsigned int i = 1; i+1 < token.size(); i++) {
+      if(token[i] != '1')
+	continue;
+      RefinementCounts C, D;
+      if(!get(token.substr(0, i+1), C) || !get(token.substr(i), D))
+	continue;
+      uint64_t d = D.n + D.s;
+      c.s = C.s * D.s;
+      c.n = (D.n + d) * C.n + d * C.s - C.s * D.s;
+      counts[token] = c;
+      sources[token] = "Lemma 1";
+      return true;
+    }
+    return false;
+  }
+
+  bool RefinementAggregator::get(const std::string &token, RefinementCounts &c) {
+    return lookup(token, c) || derive(token, c);
+  }
+
+  void RefinementAggregator::sumCompositions(const std::string &prefix, int remaining, int height, bool print, RefinementCounts &sum, std::vector<std::string> &missing) {
+    if(remaining == 0) {
+      if((int)prefix.size() != height)
+	return;
+      RefinementCounts c;
+      if(!get(prefix, c)) {
+	missing.push_back(prefix);
+	if(print)
+	  std::cout << "  <" << prefix << "> #" << std::endl;
+	return;
+      }
+      sum.n += c.n;
+      sum.s += c.s;
+      // Only print one of <Z1..Zh> and <Zh..Z1>:
+      std::string reversed = reverseToken(prefix);
+      if(print && prefix >= reversed && c.all() > 0) {
+	std::cout << "  <" << prefix << "> " << c;
+	if(seconds.find(prefix) != seconds.end())
+	  std::cout << " " << seconds[prefix] << "s";
+	else if(seconds.find(reversed) != seconds.end())
+	  std::cout << " " << seconds[reversed] << "s";
+	std::cout << " [" << sources[counts.find(prefix) != counts.end() ? prefix : reversed] << "]" << std::endl;
+      }
+      return;
+    }
+    if((int)prefix.size() >= height)
+      return; // Too tall!
+    for(int i = std::min(MAX_LAYER_SIZE, remaining); i > 0; i--) {
+      std::string token(prefix);
+      token += (char)('0' + i);
+      sumCompositions(token, remaining - i, height, print, sum, missing);
+    }
+  }
+
+  RefinementCounts RefinementAggregator::sumForHeight(int size, int height, bool print, std::vector<std::string> &missing) {
+    RefinementCounts sum;
+    sumCompositions("", size, height, print, sum, missing);
+    return sum;
+  }
+
+  bool RefinementAggregator::report(int maxSize) {
+    bool ok = !conflict;
+    for(int size = 1; size <= maxSize; size++) {
+      std::cout << std::endl << "Refinements of size " << size << std::endl;
+      RefinementCounts total;
+      std::vector<std::string> missing;
+      for(int height = 1; height <= size; height++) {
+	std::cout << " Height " << height << std::endl;
+	RefinementCounts sum = sumForHeight(size, height, true, missing);
+	std::cout << "   SUM " << sum << std::endl;
+	total.n += sum.n;
+	total.s += sum.s;
+      }
+
+      // Running time of refinements timed individually:
+      double t = 0;
+      int timed = 0;
+      for(std::map<std::string,double>::const_iterator it = seconds.begin(); it != seconds.end(); it++) {
+	if(sizeOfToken(it->first) == size) {
+	  t += it->second;
+	  timed++;
+	}
+      }
+      if(timed > 0)
+	std::cout << " Running time of " << timed << " timed refinements: " << t << "s" << std::endl;
+      if(runtimes.find(size) != runtimes.end())
+	std::cout << " Running time reported for size " << size << ": " << runtimes[size] << "s" << std::endl;
+
+      std::cout << "TOTAL " << total;
+      if(!missing.empty()) {
+	std::cout << " INCOMPLETE. Missing " << missing.size() << " refinements:";
+	for(std::vector<std::string>::const_iterator it = missing.begin(); it != missing.end(); it++)
+	  std::cout << " <" << *it << ">";
+	std::cout << std::endl;
+	ok = false; // A partial total can not be checked.
+      }
+      else if(size < 7) {
+	if(total.all() == KnownTotals[size]) {
+	  std::cout << " OK" << std::endl;
+	}
+	else {
+	  std::cout << " MISMATCH! Expected " << KnownTotals[size] << std::endl;
+	  ok = false;
+	}
+      }
+      else {
+	std::cout << std::endl;
+      }
+    }
+    return ok;
+  }
+
+  namespace {
+    // Sum of the products f[i1-1]*...*f[ic-1] over all compositions i1+...+ic of remainingN:
+    uint64_t sumProducts(int remainingCount, int remainingN, const uint64_t *f) {
+      if(remainingCount == 0)
+	return remainingN == 0 ? 1 : 0;
+      uint64_t ret = 0;
+      for(int i = 1; i <= remainingN; i++)
+	ret += f[i-1] * sumProducts(remainingCount-1, remainingN-i, f);
+      return ret;
+    }
+  }
+
+  /*
+    Recreates Table 7 from Eilers (2016) and computes a(n) using 2.3 from Eilers (2016).
+    a(n) uses C and C180 of sizes up to n and f and f180 of sizes up to n-1. a(n) is not computed if refinements for these are missing.
+   */
+  void RefinementAggregator::reportEilers(int to) {
+    uint64_t f[MAX_SIZE] = {}, f180[MAX_SIZE] = {}; // c with line on top in Table 7
+    uint64_t C[MAX_SIZE][MAX_SIZE] = {}, C180[MAX_SIZE][MAX_SIZE] = {}, C90[MAX_SIZE][MAX_SIZE] = {}; // c(n,m) with bold c
+    bool fMissing[MAX_SIZE] = {}, CMissing[MAX_SIZE] = {}; // Refinements were missing when computing f(n) or C(n,m)
+    if(to >= 8)
+      C90[7][3] = 244;
+
+    // Go through all refinements where all layers but the first have at least 2 bricks:
+    std::vector<std::pair<std::string,int> > stack; // prefix, remaining
+    for(int n = 1; n <= to; n++)
+      stack.push_back(std::make_pair(std::string(), n));
+    while(!stack.empty()) {
+      std::string prefix = stack.back().first;
+      int remaining = stack.back().second;
+      stack.pop_back();
+      if(remaining == 0) {
+	int n = sizeOfToken(prefix);
+	RefinementCounts c;
+	if(prefix[0] == '1') {
+	  if(get(prefix + "1", c)) {
+	    f[n-1] += 2 * c.n + c.s;
+	    f180[n-1] += c.s;
+	  }
+	  else
+	    fMissing[n-1] = true;
+	}
+	int firstLayer = prefix[0] - '0';
+	if(get(prefix, c)) {
+	  C[n-1][firstLayer-1] += (2 * c.n + c.s) * firstLayer;
+	  C180[n-1][firstLayer-1] += c.s * firstLayer;
+	}
+	else
+	  CMissing[n-1] = true;
+	continue;
+      }
+      for(int m = prefix.empty() ? 1 : 2; m <= std::min(remaining, MAX_LAYER_SIZE); m++) {
+	std::string token(prefix);
+	token += (char)('0' + m);
+	stack.push_back(std::make_pair(token, remaining - m));
+      }
+    }
+
+    std::cout << std::endl << "n\tf(n)\tf180(n)";
+    for(int m = 1; m <= to; m++)
+      std::cout << "\tC(n," << m << ")\tC180(n," << m << ")";
+    std::cout << std::endl;
+    for(int n = 0; n < to; n++) {
+      std::cout << (n+1) << "\t" << f[n] << "\t" << f180[n];
+      for(int m = 0; m < to; m++)
+	std::cout << "\t" << C[n][m] << "\t" << C180[n][m];
+      std::cout << std::endl;
+    }
+
+    bool complete = true;
+    for(int n = 1; n <= to; n++) {
+      complete = complete && !CMissing[n-1] && (n == 1 || !fMissing[n-2]);
+      if(!complete) {
+	std::cout << "a(" << n << ") INCOMPLETE" << std::endl;
+	continue;
+      }
+      long double an = 0;
+      // First row sum:
+      for(int m = 2; m <= n; m++)
+	an += (C[n-1][m-1] + C180[n-1][m-1] + 2 * C90[n-1][m-1]) / (long double)(2 * m);
+      // Second row first sum:
+      uint64_t suml = 0;
+      for(int l = 0; l < n; l++) {
+	for(int m1 = 1; m1 <= n; m1++) {
+	  for(int m2 = 1; m2 <= n+1-m1; m2++) {
+	    suml += C[m1-1][0] * C[m2-1][0] * sumProducts(l, n+1-m1-m2, f);
+	    suml += C180[m1-1][0] * C180[m2-1][0] * sumProducts(l, n+1-m1-m2, f180);
+	  }
+	}
+      }
+      an += suml / 2.0L;
+      std::cout << "a(" << n << ") = " << (uint64_t)(an + 0.5L) << std::endl;
+    }
+  }
+
+} // namespace rectilinear
@@ -0,0 +1,71 @@
+#ifndef REFINEMENTS_H
+#define REFINEMENTS_H
+
+// Largest model size handled. Tokens are kept as strings as <11111111111> does not fit in an int.
+#define MAX_SIZE 11
+// At most 9 bricks in a layer, so each layer is a single digit of the token.
+#define MAX_LAYER_SIZE 9
+
+#include "stdint.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace rectilinear {
+
+  /**
+   * Counts for a refinement as used in refinements.py:
+   * n is the number of models that are not 180 degree symmetric, s is the number of symmetric models.
+   */
+  struct RefinementCounts {
+    uint64_t n, s;
+
+    RefinementCounts();
+    RefinementCounts(uint64_t n, uint64_t s);
+    RefinementCounts(const RefinementCounts &c);
+    uint64_t all() const;
+    bool operator ==(const RefinementCounts &c) const;
+    bool operator !=(const RefinementCounts &c) const;
+    friend std::ostream& operator <<(std::ostream &os, const RefinementCounts &c);
+  };
+
+  /**
+   * Collects per-refinement outputs of the counters and assembles totals per size.
+   *
+   * Input lines (other lines are ignored, so the raw output of a counter can be used):
+   *  REFINEMENT <token> <all> <symmetric180> <seconds or ->
+   *  RUNTIME <size> <seconds>
+   *
+   * Missing refinements are derived using:
+   * - Reverse-token symmetry: <Z1Z2..Zh> and <Zh..Z2Z1> have the same counts.
+   * - A(X,X): The counts for <11..1> are given by a recurrence.
+   * - Lemma 1: Refinements with a layer of size 1 (not top or bottom) are split at that layer.
+   */
+  class RefinementAggregator {
+    std::map<std::string,RefinementCounts> counts; // Read or derived counts. Keys are never reversed.
+    std::map<std::string,std::string> sources; // Token -> input file it was read from
+    std::map<std::string,double> seconds; // Only for refinements that were timed individually
+    std::map<int,double> runtimes; // Size -> total running time
+    bool conflict;
+
+    void setupAXX();
+    bool add(const std::string &token, const RefinementCounts &c, const std::string &source);
+    bool derive(const std::string &token, RefinementCounts &c);
+    bool lookup(const std::string &token, RefinementCounts &c) const;
+    RefinementCounts sumForHeight(int size, int height, bool print, std::vector<std::string> &missing);
+    void sumCompositions(const std::string &prefix, int remaining, int height, bool print, RefinementCounts &sum, std::vector<std::string> &missing);
+
+  public:
+    RefinementAggregator();
+    bool readFile(const std::string &fileName);
+    bool get(const std::string &token, RefinementCounts &c);
+    bool report(int maxSize); // Returns true if all computed totals match the known totals.
+    void reportEilers(int maxSize);
+    static bool parseRefinement(const std::string &line, std::string &token, RefinementCounts &c, std::string &time);
+    static std::string reverseToken(const std::string &token);
+    static int sizeOfToken(const std::string &token);
+  };
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef UTIL_HASH_SET_HPP
+#define UTIL_HASH_SET_HPP
+
+#include <stdint.h>
+#include <assert.h>
+#include <iostream>
+#include <vector>
+#include <utility>
+
+namespace util {
+	/*
+	Spreads the bits of a key over all 64 bits (finalizer of SplitMix64).
+	Encodings of similar models differ in few bits, so they must be mixed before they are masked.
+	*/
+	inline uint64_t hashKey(uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xBF58476D1CE4E5B9ULL;
+		x ^= x >> 27;
+		x *= 0x94D049BB133111EBULL;
+		x ^= x >> 31;
+		return x;
+	}
+	inline uint64_t hashKey(const std::pair<uint64_t, uint64_t> &x) {
+		return hashKey(x.first ^ hashKey(x.second));
+	}
+
+	/*
+	Set using open addressing with linear probing in a single array of keys.
+	The capacity is a power of two and the table is kept at most half full.
+	T() marks empty slots, so it can not be inserted. Encodings are never T() as they contain the number of connections.
+	*/
+	template <typename T>
+	class HashSet {
+	private:
+		std::vector<T> slots;
+		size_t s, mask;
+
+		inline size_t slotOf(const T &key) const {
+			size_t i = (size_t)hashKey(key) & mask;
+			while (!(slots[i] == T()) && !(slots[i] == key))
+				i = (i + 1) & mask;
+			return i;
+		}
+
+		void grow() {
+			std::vector<T> old(slots.size() * 2, T());
+			old.swap(slots);
+			mask = slots.size() - 1;
+			for (typename std::vector<T>::const_iterator it = old.begin(); it != old.end(); ++it) {
+				if (!(*it == T()))
+					slots[slotOf(*it)] = *it;
+			}
+		}
+
+	public:
+		HashSet() : slots(16, T()), s(0), mask(15) {}
+
+		inline bool contains(const T &key) const {
+			return slots[slotOf(key)] == key;
+		}
+
+		/*
+		Returns true if the key was not already in the set.
+		*/
+		bool insert(const T &key) {
+			if (key == T()) {
+				assert(false); std::cerr << "DIE X019: Empty key inserted into HashSet" << std::endl;
+				int *die = NULL; die[0] = 42;
+			}
+			size_t i = slotOf(key);
+			if (slots[i] == key)
+				return false;
+			slots[i] = key;
+			if (2 * ++s > slots.size())
+				grow();
+			return true;
+		}
+
+		inline size_t size() const {
+			return s;
+		}
+
+		void clear() {
+			std::vector<T>(16, T()).swap(slots);
+			s = 0;
+			mask = 15;
+		}
+
+		/*
+		Bytes used by the table. A std::set uses about 32 bytes per element plus the key.
+		*/
+		size_t memoryUsage() const {
+			return sizeof(HashSet) + slots.capacity() * sizeof(T);
+		}
+	};
+}
+
+#endif // UTIL_HASH_SET_HPP
@@ -3,40 +3,56 @@
 
 #include <time.h>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <mutex>
 
 #define SECONDS_BETWEEN_PROGRESS_REPORTS 10
 
 namespace util {
+	/*
+	Lock for writing to std::cout. SingleModelManagers run on multiple threads (see ModelManager::runBatch()),
+	so lines are built first and then written while holding the lock to keep them from being interleaved.
+	*/
+	inline std::mutex& outputMutex() {
+		static std::mutex m;
+		return m;
+	}
+
+	inline void writeLine(const std::string &line) {
+		std::lock_guard<std::mutex> lock(outputMutex());
+		std::cout << line << std::endl;
+	}
+
 	class ProgressWriter {
 		time_t startTime, lastReportTime;
 		unsigned long steps, step;
 		std::string reportName;
 
-		void outputTime(unsigned long time) {
+		void outputTime(std::ostream &os, unsigned long time) {
 			bool first = true;
 			if (time > 3600 * 24) { // Days:
-				std::cout << time / (3600 * 24) << " days";
+				os << time / (3600 * 24) << " days";
 				first = false;
 				time %= 3600 * 24;
 			}
 			if (time > 3600 || !first) { // Hours:
 				if (!first)
-					std::cout << ", ";
-				std::cout << time / (3600) << " hours";
+					os << ", ";
+				os << time / (3600) << " hours";
 				first = false;
 				time %= 3600;
 			}
 			if (time > 60 || !first) { // Minutes:
 				if (!first)
-					std::cout << ", ";
-				std::cout << time / (60) << " minutes";
+					os << ", ";
+				os << time / (60) << " minutes";
 				first = false;
 				time %= 60;
 			}
 			if (!first)
-				std::cout << ", ";
-			std::cout << time << " seconds";
+				os << ", ";
+			os << time << " seconds";
 		}
 
 	public:
@@ -65,11 +81,13 @@ namespace util {
 				int percentageDone = (int)(step * 100 / steps);
 
 				lastReportTime = currTime;
-				std::cout << reportName << ": " << percentageDone << "% done after ";
-				outputTime(timeElapsed);
-				std::cout << ". Estimated remaining: ";
-				outputTime(timeLeft);
-				std::cout << "." << std::endl;
+				std::stringstream ss;
+				ss << reportName << ": " << percentageDone << "% done after ";
+				outputTime(ss, timeElapsed);
+				ss << ". Estimated remaining: ";
+				outputTime(ss, timeLeft);
+				ss << ".";
+				writeLine(ss.str());
 			}
 		}
 	};
@@ -4,19 +4,32 @@
 #include <assert.h>
 #include <time.h>
 #include <stack>
+#include <algorithm>
 
 namespace util {
-	UnionFindStructure::UnionFindStructure(uint32_t size) : size(size), rootsComputed(false) {
-		parents = new uint32_t[size];
-		ranks = new uint32_t[size];
-		for (uint32_t i = 0; i < size; ++i) {
-			parents[i] = i; // Self as parent to indicate root of tree.
-			ranks[i] = 0;
-		}
+	UnionFindStructure::UnionFindStructure() : rootsComputed(false) {
+		add(1);
 	}
 	UnionFindStructure::~UnionFindStructure() {
-		assert(rootsComputed);
-		delete[] parents;
+		assert(rootsComputed || parents.size() == 1);
+	}
+
+	void UnionFindStructure::reset() {
+		parents.clear();
+		ranks.clear();
+		roots.clear();
+		rootsComputed = false;
+		add(1);
+	}
+
+	uint32_t UnionFindStructure::add(uint32_t count) {
+		assert(!rootsComputed);
+		const uint32_t first = (uint32_t)parents.size();
+		for (uint32_t i = first; i < first + count; ++i) {
+			parents.push_back(i); // Self as parent to indicate root of tree.
+			ranks.push_back(0);
+		}
+		return first;
 	}
 
 	void UnionFindStructure::performUnion(uint32_t a, uint32_t b) {
@@ -37,12 +50,9 @@ namespace util {
 		}
 	}
 
-	void UnionFindStructure::performUnion(const geometry::IntervalList &l1, const geometry::IntervalList &l2, uint32_t union1, uint32_t union2) {
+	void UnionFindStructure::performUnion(const geometry::Interval *it1, const geometry::Interval *end1, const geometry::Interval *it2, const geometry::Interval *end2, uint32_t union1, uint32_t union2) {
 		assert(!rootsComputed);
-		const geometry::Interval* it1 = l1.begin();
-		const geometry::Interval* it2 = l2.begin();
-
-		while (it1 != l1.end() && it2 != l2.end()) {
+		while (it1 != end1 && it2 != end2) {
 			if (it2->second < it1->first) {
 				++it2;
 				++union2;
@@ -66,8 +76,7 @@ namespace util {
 	}
 
 	uint32_t UnionFindStructure::find(uint32_t a) const {
-		assert(a < size);
-		assert(a >= 0);
+		assert(a < parents.size());
 		if(parents[a] != a)
 			parents[a] = find(parents[a]);
 		return parents[a];
@@ -76,180 +85,317 @@ namespace util {
 	void UnionFindStructure::computeRoots() {
 		assert(!rootsComputed);
 
-		for (uint32_t i = 0; i < size; ++i) {
+		for (uint32_t i = 0; i < parents.size(); ++i) {
 			if (parents[i] == i)
 				roots.push_back(i);
 		}
 
 		rootsComputed = true;
-		delete[] ranks;
+		ranks.clear();
 	}
 
-	IntervalUnionFind::IntervalUnionFind(unsigned int numDimensions, unsigned short const * const dimensionSizes, const geometry::IntervalListVector &M) : numStepDimensions(numDimensions - 1), unionI(0), M(M) {
-		time_t startTime, endTime;
-		time(&startTime);
+	IntervalUnionFind::IntervalUnionFind() : numStepDimensions(0), hyperplaneSize(1), numHyperplanes(1), hyperplanesAdded(0), trackBounds(false) {
+	}
+
+	IntervalUnionFind::IntervalUnionFind(unsigned int numDimensions, unsigned short const * const dimensionSizes, bool trackBounds) {
+		reset(numDimensions, dimensionSizes, trackBounds);
+	}
+
+	void IntervalUnionFind::reset(unsigned int numDimensions, unsigned short const * const dimensionSizes, bool trackBounds) {
+		numStepDimensions = numDimensions - 1;
+		hyperplaneSize = 1;
+		numHyperplanes = 1;
+		hyperplanesAdded = 0;
+		this->trackBounds = trackBounds;
+		ufs.reset();
+		previous.intervals.clear();
+		previous.cellStarts.clear();
+		current.intervals.clear();
+		current.cellStarts.clear();
+		representatives.clear();
+		pinned.clear();
+		pending.clear();
+		bounds.clear();
 
 		// Initialize members:
-		for (unsigned int i = 0; i < numDimensions; ++i)
+		for (unsigned int i = 0; i < numStepDimensions; ++i)
 			this->dimensionSizes[i] = dimensionSizes[i];
+		if (numStepDimensions > 0)
+			numHyperplanes = dimensionSizes[0];
+		for (unsigned int i = 1; i < numStepDimensions; ++i)
+			hyperplaneSize *= dimensionSizes[i];
+	}
 
-		// Initially fill basic vectors:
-		buildIntervalIndicatorToUnion();
+	/*
+	Adds the hyperplane of locations firstLocation to firstLocation+hyperplaneSize-1 in M.
+	Intervals are joined with their -1 neighbours in the same order as when the full SML grid is kept in memory,
+	so unions and representatives do not depend on how the grid is streamed.
+	*/
+	void IntervalUnionFind::addHyperplane(const geometry::IntervalListVector &M, uint32_t firstLocation, IntervalUnionFind *enclosing) {
+		assert(hyperplanesAdded < numHyperplanes);
+
+		// Copy intervals:
+		current.intervals.clear();
+		current.cellStarts.clear();
+		for (uint32_t i = 0; i < hyperplaneSize; ++i) {
+			current.cellStarts.push_back((uint32_t)current.intervals.size());
+			geometry::IntervalList l;
+			M.get(firstLocation + i, l);
+			current.intervals.insert(current.intervals.end(), l.begin(), l.end());
+		}
+		current.cellStarts.push_back((uint32_t)current.intervals.size());
+		current.firstUnion = ufs.add((uint32_t)current.intervals.size());
 
-		// Perform unions:
-		ufs = new UnionFindStructure(unionI); // Deleted in ~IntervalUnionFind()
+		// Join with each lower neighbour:
 		MixedPosition position;
-		buildUnions(0, position);
+		for (unsigned int i = 1; i < numStepDimensions; ++i)
+			position.p[i] = 0;
+		for (uint32_t cell = 0; cell < hyperplaneSize; ++cell, nextPosition(position)) {
+			const geometry::Interval *begin1 = current.intervals.data() + current.cellStarts[cell];
+			const geometry::Interval *end1 = current.intervals.data() + current.cellStarts[cell + 1];
+			if (begin1 == end1)
+				continue;
+			const uint32_t unionStart1 = current.firstUnion + current.cellStarts[cell];
+
+			// Previous hyperplane:
+			if (hyperplanesAdded > 0) {
+				ufs.performUnion(begin1, end1, previous.intervals.data() + previous.cellStarts[cell], previous.intervals.data() + previous.cellStarts[cell + 1], unionStart1, previous.firstUnion + previous.cellStarts[cell]);
+			}
+			// Same hyperplane:
+			uint32_t stride = hyperplaneSize;
+			for (unsigned int i = 1; i < numStepDimensions; ++i) {
+				stride /= dimensionSizes[i];
+				if (position.p[i] == 0)
+					continue; // Can't further decrease in this dimension.
+				const uint32_t neighbour = cell - stride;
+				ufs.performUnion(begin1, end1, current.intervals.data() + current.cellStarts[neighbour], current.intervals.data() + current.cellStarts[neighbour + 1], unionStart1, current.firstUnion + current.cellStarts[neighbour]);
+			}
+		}
+
+		// Resolve positions pinned before the hyperplane was added:
+		for (unsigned int i = 0; i < pending.size(); ++i) {
+			if (hyperplaneOf(pending[i]) != hyperplanesAdded)
+				continue;
+			resolvePin(pending[i], current);
+			pending[i--] = pending.back();
+			pending.pop_back();
+		}
 
-		ufs->computeRoots();
+		if (hyperplanesAdded > 0)
+			retire(previous, hyperplanesAdded - 1, enclosing);
+		std::swap(previous, current);
+		++hyperplanesAdded;
+	}
 
-		time(&endTime);
-		double seconds = difftime(endTime, startTime);
-		if (seconds > 2)
-			std::cout << "Union find performed in " << seconds << " seconds." << std::endl;
+	/*
+	Retires the last hyperplane. Enclosing union-find structures must be finished after this.
+	*/
+	void IntervalUnionFind::finish(IntervalUnionFind *enclosing) {
+		assert(hyperplanesAdded == numHyperplanes);
+		assert(pending.empty());
+		retire(previous, numHyperplanes - 1, enclosing);
+		previous.intervals.clear();
+		previous.cellStarts.clear();
+		current.intervals.clear();
+		current.cellStarts.clear();
+		mergeBounds();
+		ufs.computeRoots();
 	}
 
-	IntervalUnionFind::~IntervalUnionFind() {
-		delete ufs;
-		delete[] intervalIndicatorToUnion;
-		delete[] unionToInterval;
+	size_t IntervalUnionFind::capacityBytes() const {
+		return (ufs.parents.capacity() + ufs.ranks.capacity() + ufs.roots.capacity() + previous.cellStarts.capacity() + current.cellStarts.capacity()) * sizeof(uint32_t) +
+			(previous.intervals.capacity() + current.intervals.capacity()) * sizeof(geometry::Interval) + pending.capacity() * sizeof(MixedPosition);
 	}
 
-	void IntervalUnionFind::buildIntervalIndicatorToUnion() {
-		assert(unionI == 0);
-		unionI = 1;
-		intervalIndicatorToUnion = new uint32_t[M.sizeIndicator() + 1]; // Deleted in ~IntervalUnionFind()
-		unionToInterval = new std::pair<uint32_t, unsigned short>[M.sizeNonEmptyIntervals() + 1]; // Deleted in ~IntervalUnionFind()
+	size_t IntervalUnionFind::sizeBytes() const {
+		// ranks have the same size as parents until the roots are computed. Each hyperplane has hyperplaneSize+1 cell starts.
+		return (2 * ufs.parents.size() + ufs.roots.size() + 2 * (hyperplaneSize + 1)) * sizeof(uint32_t);
+	}
 
-		for (uint32_t i = 0; i < M.sizeIndicator(); ++i) {
-			unsigned short intervalSize = M.intervalSizeForIndicator(i);
-			if (intervalSize == 0) {
-				intervalIndicatorToUnion[i] = 0;
-				continue;
-			}
-			intervalIndicatorToUnion[i] = unionI;
-			assert(unionI + intervalSize <= M.sizeNonEmptyIntervals() + 1);
+	void IntervalUnionFind::retire(const IntervalHyperplane &hyperplane, uint32_t hyperplaneI, IntervalUnionFind *enclosing) {
+		// Representatives of unions that have been joined with others are no longer needed:
+		for (std::map<uint32_t, MixedPosition>::iterator it = representatives.begin(); it != representatives.end();) {
+			if (ufs.find(it->first) != it->first)
+				representatives.erase(it++);
+			else
+				++it;
+		}
+		mergeBounds();
 
-			for (unsigned short j = 0; j < intervalSize; ++j) {
-				unionToInterval[unionI + j].first = i;
-				unionToInterval[unionI + j].second = j;
+		MixedPosition position;
+		if (numStepDimensions > 0)
+			position.p[0] = (unsigned short)hyperplaneI;
+		for (unsigned int i = 1; i < numStepDimensions; ++i)
+			position.p[i] = 0;
+		for (uint32_t cell = 0; cell < hyperplaneSize; ++cell, nextPosition(position)) {
+			for (uint32_t j = hyperplane.cellStarts[cell]; j < hyperplane.cellStarts[cell + 1]; ++j) {
+				const uint32_t unionI = hyperplane.firstUnion + j;
+				if (trackBounds)
+					extendBounds(ufs.find(unionI), position);
+				if (ufs.find(unionI) != unionI)
+					continue;
+				const geometry::Interval &interval = hyperplane.intervals[j];
+				position.lastAngle = (interval.first + interval.second) / 2;
+				representatives.insert(std::make_pair(unionI, position));
+				pinned[std::make_pair(indicatorIndexOf(position), position.lastAngle)] = unionI;
+				if (enclosing != NULL)
+					enclosing->pin(position);
 			}
-			unionI += intervalSize;
 		}
 	}
 
-	void IntervalUnionFind::buildUnions(unsigned int positionI, MixedPosition &position) {
-		if (positionI < numStepDimensions) {
-			for (unsigned short i = 0; i < dimensionSizes[positionI]; ++i) {
-				position.p[positionI] = i;
-				buildUnions(positionI + 1, position);
+	/*
+	Bounds of unions that have been joined with others are moved to the root of the joined union.
+	*/
+	void IntervalUnionFind::mergeBounds() {
+		for (std::map<uint32_t, UnionBounds>::iterator it = bounds.begin(); it != bounds.end();) {
+			const uint32_t root = ufs.find(it->first);
+			if (root == it->first) {
+				++it;
+				continue;
 			}
+			MixedPosition position;
+			for (unsigned int i = 0; i < numStepDimensions; ++i)
+				position.p[i] = it->second.min[i];
+			extendBounds(root, position);
+			for (unsigned int i = 0; i < numStepDimensions; ++i)
+				position.p[i] = it->second.max[i];
+			extendBounds(root, position);
+			bounds.erase(it++);
+		}
+	}
+
+	void IntervalUnionFind::extendBounds(uint32_t unionI, const MixedPosition &position) {
+		std::map<uint32_t, UnionBounds>::iterator it = bounds.find(unionI);
+		if (it == bounds.end()) {
+			UnionBounds b;
+			for (unsigned int i = 0; i < numStepDimensions; ++i)
+				b.min[i] = b.max[i] = position.p[i];
+			bounds.insert(std::make_pair(unionI, b));
 			return;
 		}
+		for (unsigned int i = 0; i < numStepDimensions; ++i) {
+			if (position.p[i] < it->second.min[i])
+				it->second.min[i] = position.p[i];
+			if (position.p[i] > it->second.max[i])
+				it->second.max[i] = position.p[i];
+		}
+	}
 
-		uint32_t positionIndex = indicatorIndexOf(position);
-		geometry::IntervalList l1;
-		M.get(positionIndex, l1);
-		if (l1.empty())
+	/*
+	Ensures getRootForPosition() can be called for the position after its hyperplane has been retired.
+	*/
+	void IntervalUnionFind::pin(const MixedPosition &position) {
+		const uint32_t hyperplaneI = hyperplaneOf(position);
+		if (hyperplaneI >= hyperplanesAdded) {
+			pending.push_back(position);
 			return;
-		const uint32_t unionStart1 = intervalIndicatorToUnion[positionIndex];
+		}
+		if (hyperplaneI + 1 != hyperplanesAdded) {
+			assert(false); std::cerr << "DIE X020: Position pinned in retired hyperplane " << hyperplaneI << std::endl;
+			int *die = NULL; die[0] = 42;
+		}
+		resolvePin(position, previous);
+	}
 
-		// Run and join for each lower dimension:
-		for (unsigned int i = 0; i < numStepDimensions; ++i) {
-			if (position.p[i] == 0)
-				continue; // Can't further decrease in this dimension.
-			--position.p[i];
-			uint32_t neighbourPositionIndex = indicatorIndexOf(position);
-			++position.p[i];
-
-			// Join all in dimension:
-			geometry::IntervalList l2;
-			M.get(neighbourPositionIndex, l2);
-			if (l2.empty())
-				continue;
-			const uint32_t unionStart2 = intervalIndicatorToUnion[neighbourPositionIndex];
+	void IntervalUnionFind::resolvePin(const MixedPosition &position, const IntervalHyperplane &hyperplane) {
+		const uint32_t indicatorIndex = indicatorIndexOf(position);
+		const uint32_t cell = indicatorIndex % hyperplaneSize;
+		uint32_t unionI = 0;
+		for (uint32_t j = hyperplane.cellStarts[cell]; j < hyperplane.cellStarts[cell + 1]; ++j) {
+			const geometry::Interval &interval = hyperplane.intervals[j];
+			if (interval.first <= position.lastAngle && position.lastAngle <= interval.second) {
+				unionI = hyperplane.firstUnion + j;
+				break;
+			}
+		}
+		pinned.insert(std::make_pair(std::make_pair(indicatorIndex, position.lastAngle), unionI));
+	}
 
-			ufs->performUnion(l1, l2, unionStart1, unionStart2);
+	/*
+	Advances position to the next position of the hyperplane in row-major order.
+	*/
+	void IntervalUnionFind::nextPosition(MixedPosition &position) const {
+		for (unsigned int i = numStepDimensions; i > 1; --i) {
+			if (++position.p[i - 1] < dimensionSizes[i - 1])
+				return;
+			position.p[i - 1] = 0;
 		}
 	}
 
+	uint32_t IntervalUnionFind::hyperplaneOf(const MixedPosition &position) const {
+		return numStepDimensions == 0 ? 0 : position.p[0];
+	}
+
 	uint32_t IntervalUnionFind::indicatorIndexOf(const MixedPosition &position) const {
 		uint32_t index = numStepDimensions == 0 ? 0 : position.p[0];
 		for (unsigned int i = 1; i < numStepDimensions; ++i)
 			index = (index * dimensionSizes[i]) + position.p[i];
+		return index;
+	}
 
-#ifdef _DEBUG
-		if (intervalIndicatorToUnion[index] == 0) 
-			return index;
-		MixedPosition rep;
-		getRepresentativeOfUnion(intervalIndicatorToUnion[index], rep);
-		for (unsigned int i = 0; i < numStepDimensions; ++i) {
-			if (rep.p[i] != position.p[i]) {
-				std::cout << "Error in representation juggling! Number stepping angles: " << numStepDimensions << std::endl;
-				std::cout << " Failing index: " << i << std::endl;
-				std::cout << " Index of indicator: " << index << std::endl;
-				std::cout << " Index of union: " << intervalIndicatorToUnion[index] << std::endl;
-				std::cout << " Indicator info: Index: " << unionToInterval[intervalIndicatorToUnion[index]].first << ", size: " << unionToInterval[intervalIndicatorToUnion[index]].second << std::endl;
-				std::cout << " Number of steps: " << std::endl;
-				for (unsigned int j = 0; j < numStepDimensions; ++j)
-					std::cout << "  Step angle " << j << ": " << dimensionSizes[j] << std::endl;
-				std::cout << " Positions: " << std::endl;
-				for (unsigned int j = 0; j < numStepDimensions; ++j)
-					std::cout << "  Step angle " << j << ". Input: " << position.p[j] << ", check: " << rep.p[i] << std::endl;
-				assert(false); std::cerr << "DIE X018" << std::endl;
-				int *die = NULL; die[0] = 42;
-			}
-			assert(rep.p[i] == position.p[i]);
+	std::map<std::pair<uint32_t, double>, uint32_t>::const_iterator IntervalUnionFind::findPinned(const MixedPosition &position) const {
+		std::map<std::pair<uint32_t, double>, uint32_t>::const_iterator it = pinned.find(std::make_pair(indicatorIndexOf(position), position.lastAngle));
+		if (it == pinned.end()) {
+			assert(false); std::cerr << "DIE X021: Position was not pinned" << std::endl;
+			int *die = NULL; die[0] = 42;
 		}
-#endif
+		return it;
+	}
 
-		return index;
+	bool IntervalUnionFind::contains(const MixedPosition &position) const {
+		return findPinned(position)->second != 0;
 	}
 
 	uint32_t IntervalUnionFind::getRootForPosition(const MixedPosition rep) const {
-		uint32_t indicatorIndex = indicatorIndexOf(rep);
-		assert(indicatorIndex < M.sizeIndicator());
-		uint32_t firstUnion = intervalIndicatorToUnion[indicatorIndex];
-
-		geometry::IntervalList l;
-		M.get(indicatorIndex, l);
-		uint32_t index = 0;
-		for (const geometry::Interval* it = l.begin(); it != l.end(); ++it, ++index) {
-			if (it->first <= rep.lastAngle && rep.lastAngle <= it->second) {
-				return ufs->find(firstUnion + index);
-			}
+		const uint32_t unionI = findPinned(rep)->second;
+		if (unionI == 0) {
+			assert(false); std::cerr << "DIE X007" << std::endl;
+			int *die = NULL; die[0] = 42;
 		}
-
-		assert(false); std::cerr << "DIE X007" << std::endl;
-		int *die = NULL; die[0] = 42;
-		return 0;
+		return ufs.find(unionI);
 	}
 
 	void IntervalUnionFind::getRepresentativeOfUnion(unsigned int _unionI, MixedPosition &rep) const {
 		assert(_unionI != 0);
-		assert(_unionI < M.sizeNonEmptyIntervals() + 1);
-		std::pair<uint32_t, unsigned short> intervalInfo = unionToInterval[_unionI];
-
-		// Construct position from interval index:
-		uint32_t encodedPosition = intervalInfo.first;
-		for (unsigned int i = 0; i < numStepDimensions; ++i) {
-			int revDim = numStepDimensions - i - 1;
-			rep.p[revDim] = encodedPosition % dimensionSizes[revDim];
-			encodedPosition /= dimensionSizes[revDim];
+		std::map<uint32_t, MixedPosition>::const_iterator it = representatives.find(_unionI);
+		if (it == representatives.end()) {
+			assert(false); std::cerr << "DIE X022: No representative for union " << _unionI << std::endl;
+			int *die = NULL; die[0] = 42;
 		}
+		rep = it->second;
+	}
 
-		// Get angle from M:
-		geometry::Interval interval = M.get(intervalInfo.first, intervalInfo.second);
-		rep.lastAngle = (interval.first + interval.second) / 2;
+	const UnionBounds& IntervalUnionFind::getBoundsOfUnion(unsigned int _unionI) const {
+		assert(trackBounds);
+		std::map<uint32_t, UnionBounds>::const_iterator it = bounds.find(_unionI);
+		if (it == bounds.end()) {
+			assert(false); std::cerr << "DIE X023: No bounds for union " << _unionI << std::endl;
+			int *die = NULL; die[0] = 42;
+		}
+		return it->second;
 	}
 
 	std::vector<uint32_t>::const_iterator IntervalUnionFind::rootsBegin() const {
-		std::vector<uint32_t>::const_iterator ret = ufs->roots.begin();
+		std::vector<uint32_t>::const_iterator ret = ufs.roots.begin();
 		++ret;
 		return ret;
 	}
 
 	std::vector<uint32_t>::const_iterator IntervalUnionFind::rootsEnd() const {
-		return ufs->roots.end();
+		return ufs.roots.end();
+	}
+
+	uint32_t IntervalUnionFind::numRoots() const {
+		return (uint32_t)(rootsEnd() - rootsBegin());
+	}
+
+	/*
+	Roots are computed in increasing order, so they can be binary searched.
+	*/
+	uint32_t IntervalUnionFind::getIndexOfRoot(uint32_t root) const {
+		std::vector<uint32_t>::const_iterator it = std::lower_bound(rootsBegin(), rootsEnd(), root);
+		assert(it != rootsEnd() && *it == root);
+		return (uint32_t)(it - rootsBegin());
 	}
 }
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <vector>
+#include <map>
 
 #include "../geometry/BasicGeometry.h"
 
@@ -22,46 +23,101 @@ struct MixedPosition {
 namespace util {
 	/*
 	Basic UF structure with path compression: https://en.wikipedia.org/wiki/Disjoint-set_data_structure
+	Element 0 is not part of any union. Elements are added as the SML matrix is streamed.
 	*/
 	struct UnionFindStructure {
-		uint32_t size;
-		uint32_t *parents, *ranks; // parents, and sizes (ranks) of trees.
+		mutable std::vector<uint32_t> parents;
+		std::vector<uint32_t> ranks; // parents, and sizes (ranks) of trees.
 		bool rootsComputed;
 		std::vector<uint32_t> roots;
 
-		UnionFindStructure(uint32_t size);
+		UnionFindStructure();
 		~UnionFindStructure();
 
+		void reset(); // Removes all elements but keeps the capacity of the vectors.
+
+		uint32_t add(uint32_t count); // Returns the first of the added elements.
 		void performUnion(uint32_t a, uint32_t b);
-		void performUnion(const geometry::IntervalList &l1, const geometry::IntervalList &l2, uint32_t unionStart1, uint32_t unionStart2);
+		void performUnion(const geometry::Interval *begin1, const geometry::Interval *end1, const geometry::Interval *begin2, const geometry::Interval *end2, uint32_t unionStart1, uint32_t unionStart2);
 		uint32_t find(uint32_t a) const;
 		void computeRoots();
 	};
 
+	/*
+	Intervals of a hyperplane of the SML grid: All positions with the same step of the first angle.
+	The intervals of position i in the hyperplane are intervals[cellStarts[i]] to intervals[cellStarts[i+1]-1].
+	Interval j of the hyperplane is union firstUnion+j.
+	*/
+	struct IntervalHyperplane {
+		std::vector<geometry::Interval> intervals;
+		std::vector<uint32_t> cellStarts;
+		uint32_t firstUnion;
+	};
+
+	/*
+	Bounding box of the step positions of a union.
+	*/
+	struct UnionBounds {
+		unsigned short min[MAX_DIMENSIONS - 1], max[MAX_DIMENSIONS - 1];
+	};
+
+	/*
+	Union-find over the intervals of the SML grid, which is added one hyperplane at a time in row-major order.
+	Only the last hyperplane is kept, as intervals are only joined with their -1 neighbours.
+
+	Positions can not be looked up once their hyperplane has been retired, so:
+	- Representatives are kept for the unions which were roots when their hyperplane was retired.
+	- Positions used with getRootForPosition() must be pinned before their hyperplane is retired.
+	  The representatives of a union-find are pinned in the enclosing union-find (L in M and M in S) when retired.
+	*/
 	class IntervalUnionFind {
 	private:
 		unsigned int numStepDimensions;
 		unsigned short dimensionSizes[MAX_DIMENSIONS - 1]; // "-1" because last dimension is not a step dimension.
+		uint32_t hyperplaneSize, numHyperplanes, hyperplanesAdded;
 
-		UnionFindStructure *ufs;
-		uint32_t *intervalIndicatorToUnion, unionI;
-		std::pair<uint32_t, unsigned short> *unionToInterval;
-		const geometry::IntervalListVector &M; // ref only, no ownership.
+		UnionFindStructure ufs;
+		IntervalHyperplane previous, current;
+		std::map<uint32_t, MixedPosition> representatives; // Union -> representative.
+		std::map<std::pair<uint32_t, double>, uint32_t> pinned; // (indicator index, last angle) -> union. 0 if not in any interval.
+		std::vector<MixedPosition> pending; // Pinned positions of hyperplanes that have not yet been added.
+		bool trackBounds;
+		std::map<uint32_t, UnionBounds> bounds; // Union -> bounds. Only kept when trackBounds.
 
-		void buildIntervalIndicatorToUnion();
-		void buildUnions(unsigned int positionI, MixedPosition &position);
+		void resolvePin(const MixedPosition &position, const IntervalHyperplane &hyperplane);
+		void retire(const IntervalHyperplane &hyperplane, uint32_t hyperplaneI, IntervalUnionFind *enclosing);
+		void mergeBounds();
+		void extendBounds(uint32_t unionI, const MixedPosition &position);
+		void nextPosition(MixedPosition &position) const;
+		uint32_t hyperplaneOf(const MixedPosition &position) const;
 		uint32_t indicatorIndexOf(const MixedPosition &position) const;
+		std::map<std::pair<uint32_t, double>, uint32_t>::const_iterator findPinned(const MixedPosition &position) const;
 
-		IntervalUnionFind(); // Undefined
 		IntervalUnionFind& operator=(const IntervalUnionFind &); // Undefined
 	public:
-		IntervalUnionFind(unsigned int numDimensions, unsigned short const * const dimensionSizes, const geometry::IntervalListVector &M);
-		~IntervalUnionFind();
+		IntervalUnionFind(); // Must be reset() before use.
+		IntervalUnionFind(unsigned int numDimensions, unsigned short const * const dimensionSizes, bool trackBounds);
+
+		/*
+		Prepares the structure for a new SML grid as if it was constructed again.
+		Vectors keep their capacity, so a structure reused across attempts only allocates when a grid needs more than any previous grid.
+		*/
+		void reset(unsigned int numDimensions, unsigned short const * const dimensionSizes, bool trackBounds);
+		size_t capacityBytes() const; // Bytes held by the vectors.
+		size_t sizeBytes() const; // Bytes of the vectors needed for the current grid.
+
+		void pin(const MixedPosition &position);
+		void addHyperplane(const geometry::IntervalListVector &M, uint32_t firstLocation, IntervalUnionFind *enclosing);
+		void finish(IntervalUnionFind *enclosing);
 
+		bool contains(const MixedPosition &position) const;
 		uint32_t getRootForPosition(const MixedPosition rep) const;
 		void getRepresentativeOfUnion(unsigned int unionI, MixedPosition &rep) const;
+		const UnionBounds& getBoundsOfUnion(unsigned int unionI) const;
 		std::vector<uint32_t>::const_iterator rootsBegin() const;
 		std::vector<uint32_t>::const_iterator rootsEnd() const;
+		uint32_t numRoots() const;
+		uint32_t getIndexOfRoot(uint32_t root) const; // Index of the root in rootsBegin() to rootsEnd().
 	};
 }
 
@@ -0,0 +1,173 @@
+﻿#include "stdafx.h"
+#include "../BrickCountingCore/modelling/BrickCollision.h"
+
+using namespace System;
+using namespace System::Text;
+using namespace System::Collections::Generic;
+using namespace Microsoft::VisualStudio::TestTools::UnitTesting;
+
+/*
+Differential tests of the collision kernels (SIMD or scalar depending on the build) against Brick::intersects().
+The separating axis test is also compared to the POIs.
+Each test has its own seed, so the bricks of a test do not depend on which tests ran before it.
+*/
+namespace {
+	// Deterministic pseudo random number in [min;max]:
+	double random(unsigned int &seed, double min, double max) {
+		seed = seed * 1103515245 + 12345;
+		return min + (max - min) * ((seed >> 8) & 0xFFFF) / 65535.0;
+	}
+
+	/*
+	Brick near b. Every fourth brick is rectilinear to b, so that bricks touching along their sides are included.
+	*/
+	modelling::Brick randomBrickNear(unsigned int &seed, const modelling::Brick &b) {
+		const int8_t level = (int8_t)(b.level + (int)random(seed, -2, 2.99));
+		if (random(seed, 0, 1) < 0.25)
+			return modelling::Brick(b.center.X + (int)random(seed, -4, 4), b.center.Y + (int)random(seed, -4, 4), b.angle + M_PI / 2 * (int)random(seed, 0, 3.99), level);
+		return modelling::Brick(b.center.X + random(seed, -5, 5), b.center.Y + random(seed, -5, 5), random(seed, -M_PI, M_PI), level);
+	}
+
+	template <int ADD_XY>
+	bool intersectsUnconnected(const modelling::Brick &a, const modelling::Brick &b) {
+		bool connected;
+		modelling::ConnectionPoint foundA, foundB;
+		modelling::RectilinearBrick source;
+		return a.intersects<ADD_XY>(b, source, connected, foundB, foundA, source) && !connected;
+	}
+
+	template <int ADD_XY>
+	bool intersectsUnconnected(const modelling::BrickPairGeometry &g) {
+		bool connected;
+		return g.intersects<ADD_XY>(connected) && !connected;
+	}
+
+	/*
+	The boxes of a and b touch at ADD_XY: The separating axis test one ADD_XY step smaller and one step larger disagree.
+	The POIs and the separating axis test apply EPSILON differently, so they may disagree on such pairs.
+	*/
+	template <int ADD_XY>
+	bool boxesTouch(const modelling::Brick &a, const modelling::Brick &b) {
+		return a.boxesIntersectSAT<ADD_XY - 1>(b) != a.boxesIntersectSAT<ADD_XY + 1>(b);
+	}
+}
+
+namespace Test
+{
+	[TestClass]
+	public ref class TestBrickCollision
+	{
+	private:
+		TestContext^ testContextInstance;
+
+	public: 
+		/// <summary>
+		///Gets or sets the test context which provides
+		///information about and functionality for the current test run.
+		///</summary>
+		property Microsoft::VisualStudio::TestTools::UnitTesting::TestContext^ TestContext
+		{
+			Microsoft::VisualStudio::TestTools::UnitTesting::TestContext^ get()
+			{
+				return testContextInstance;
+			}
+			System::Void set(Microsoft::VisualStudio::TestTools::UnitTesting::TestContext^ value)
+			{
+				testContextInstance = value;
+			}
+		};
+
+		#pragma region Additional test attributes
+		//
+		//You can use the following additional attributes as you write your tests:
+		//
+		//Use ClassInitialize to run code before running the first test in the class
+		//[ClassInitialize()]
+		//static void MyClassInitialize(TestContext^ testContext) {};
+		//
+		//Use ClassCleanup to run code after all tests in a class have run
+		//[ClassCleanup()]
+		//static void MyClassCleanup() {};
+		//
+		//Use TestInitialize to run code before running each test
+		//[TestInitialize()]
+		//void MyTestInitialize() {};
+		//
+		//Use TestCleanup to run code after each test has run
+		//[TestCleanup()]
+		//void MyTestCleanup() {};
+		//
+		#pragma endregion 
+
+		[TestMethod]
+		void TestPairGeometryAgreesWithIntersects()
+		{
+			unsigned int seed = 42;
+			for (int i = 0; i < 100000; ++i) {
+				modelling::Brick a(random(seed, -1, 1), random(seed, -1, 1), random(seed, -M_PI, M_PI), 0);
+				modelling::Brick b = randomBrickNear(seed, a);
+				modelling::BrickPairGeometry g(a, b);
+
+				assert(intersectsUnconnected<-MOLDING_TOLERANCE_MULTIPLIER>(g) == intersectsUnconnected<-MOLDING_TOLERANCE_MULTIPLIER>(a, b));
+				assert(intersectsUnconnected<0>(g) == intersectsUnconnected<0>(a, b));
+				assert(intersectsUnconnected<MOLDING_TOLERANCE_MULTIPLIER>(g) == intersectsUnconnected<MOLDING_TOLERANCE_MULTIPLIER>(a, b));
+			}
+		};
+
+		[TestMethod]
+		void TestBrickSoAAgreesWithIntersects()
+		{
+			unsigned int seed = 42;
+			for (int i = 0; i < 20000; ++i) {
+				modelling::Brick b(random(seed, -1, 1), random(seed, -1, 1), random(seed, -M_PI, M_PI), 0);
+				modelling::BrickSoA soa;
+				const int size = (int)random(seed, 1, 5.99);
+				for (int j = 0; j < size; ++j)
+					soa.push_back(randomBrickNear(seed, b));
+
+				const unsigned int candidates = soa.candidatesFor(b);
+				for (int j = 0; j < size; ++j) {
+					const modelling::Brick a = soa.get(j);
+					if ((candidates & (1u << j)) == 0) {
+						assert(modelling::BrickPairGeometry(a, b).isClear());
+						continue;
+					}
+					modelling::BrickPairGeometry g(soa, j, b, sin(-b.angle), cos(-b.angle));
+					assert(intersectsUnconnected<-MOLDING_TOLERANCE_MULTIPLIER>(g) == intersectsUnconnected<-MOLDING_TOLERANCE_MULTIPLIER>(a, b));
+					assert(intersectsUnconnected<0>(g) == intersectsUnconnected<0>(a, b));
+					assert(intersectsUnconnected<MOLDING_TOLERANCE_MULTIPLIER>(g) == intersectsUnconnected<MOLDING_TOLERANCE_MULTIPLIER>(a, b));
+				}
+			}
+		};
+
+		[TestMethod]
+		void TestPOIKernelAgreesWithScalar()
+		{
+			unsigned int seed = 42;
+			for (int i = 0; i < 100000; ++i) {
+				modelling::Brick b(random(seed, -4, 4), random(seed, -4, 4), random(seed, -M_PI, M_PI), 0);
+				const double sina = sin(b.angle), cosa = cos(b.angle);
+				geometry::Point pois[NUMBER_OF_POIS_FOR_BOX_INTERSECTION];
+
+				b.getBoxPOIs<0>(sina, cosa, pois);
+				assert(modelling::boxContainsAnyPOIOf<0>(b, sina, cosa) == modelling::Brick::boxContainsAnyPOI<0>(pois));
+				b.getBoxPOIs<MOLDING_TOLERANCE_MULTIPLIER>(sina, cosa, pois);
+				assert(modelling::boxContainsAnyPOIOf<MOLDING_TOLERANCE_MULTIPLIER>(b, sina, cosa) == modelling::Brick::boxContainsAnyPOI<MOLDING_TOLERANCE_MULTIPLIER>(pois));
+			}
+		};
+
+		[TestMethod]
+		void TestSATAgreesWithPOIs()
+		{
+			unsigned int seed = 42;
+			for (int i = 0; i < 200000; ++i) {
+				modelling::Brick a(random(seed, -1, 1), random(seed, -1, 1), random(seed, -M_PI, M_PI), 0);
+				modelling::Brick b = randomBrickNear(seed, a);
+
+				assert(boxesTouch<-MOLDING_TOLERANCE_MULTIPLIER>(a, b) || a.boxesIntersectSAT<-MOLDING_TOLERANCE_MULTIPLIER>(b) == a.boxesIntersectPOI<-MOLDING_TOLERANCE_MULTIPLIER>(b));
+				assert(boxesTouch<0>(a, b) || a.boxesIntersectSAT<0>(b) == a.boxesIntersectPOI<0>(b));
+				assert(boxesTouch<MOLDING_TOLERANCE_MULTIPLIER>(a, b) || a.boxesIntersectSAT<MOLDING_TOLERANCE_MULTIPLIER>(b) == a.boxesIntersectPOI<MOLDING_TOLERANCE_MULTIPLIER>(b));
+			}
+		};
+	};
+}
@@ -69,12 +69,28 @@ namespace Test
 		void TestAnalyzePointToCircleOutOfReach2()
 		{
 			double ab = 3, bc = 1, Ey = 1, radiusE = 1;
-			//geometry::AngleRestrictorFunctionList arfl;
-			//geometry::TwinJointRobotArmMotionAnalyzer analyzer(ab, bc);
+			geometry::AngleRestrictorFunctionList arfl;
+			geometry::TwinJointRobotArmMotionAnalyzer analyzer(ab, bc);
+
+			analyzer.analyzePointToCircle(Ey, radiusE, true, arfl);
+
+			assert(arfl.empty());
+		};
 
-			//analyzer.analyzePointToCircle(Ey, radiusE, true, arfl);
+		[TestMethod]
+		void TestAnalyzePointToCircleInReach()
+		{
+			double ab = 2, bc = 1, Ey = 3, radiusE = 0.5;
+			geometry::AngleRestrictorFunctionList arfl;
+			geometry::TwinJointRobotArmMotionAnalyzer analyzer(ab, bc);
+
+			analyzer.analyzePointToCircle(Ey, radiusE, true, arfl);
 
-			//assert(arfl.empty());
+			// Arm pointing straight up reaches E when BC is straight:
+			assert(arfl.size() == 1);
+			assert(geometry::inRadianInterval(M_PI / 2, arfl[0].primaryInterval));
+			assert(geometry::inRadianInterval(0, arfl[0].restrictionFunction(M_PI / 2)));
+			assert(!geometry::inRadianInterval(M_PI, arfl[0].restrictionFunction(M_PI / 2)));
 		};
 	};
 }